@@ -0,0 +1,20 @@
+QT += core widgets opengl openglwidgets
+
+TARGET = MiniMinecraft
+TEMPLATE = app
+CONFIG += console
+win32 {
+    LIBS += -lopengl32
+#    LIBS += -lglut32
+    LIBS += -lglu32
+}
+
+include(../common.pri)
+include(../core/core_link.pri)
+include(../src/src.pri)
+
+FORMS += ../forms/mainwindow.ui \
+    ../forms/cameracontrolshelp.ui \
+    ../forms/playerinfo.ui
+
+RESOURCES += ../glsl.qrc
@@ -0,0 +1,15 @@
+# Console benchmark of the world core. Runs without a window or GL context.
+TARGET = corebenchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+include(../common.pri)
+include(../core/core_link.pri)
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/corebenchmark.cpp
+
+HEADERS += \
+    $$PWD/corebenchmark.h
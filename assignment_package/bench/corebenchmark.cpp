@@ -0,0 +1,1930 @@
+#include "corebenchmark.h"
+#include "scene/chunk.h"
+#include "scene/chunkpool.h"
+#include "scene/chunksnapshot.h"
+#include "scene/collision.h"
+#include "scene/faceshading.h"
+#include "scene/mobsystem.h"
+#include "scene/noise.h"
+#include "scene/spatialhash.h"
+#include "quadindices.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The value below which the given fraction of the values lie
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+// Writes the per-repetition times of a suite and their summary
+static void writeTimes(std::ostream &out, const std::vector<double> &ms)
+{
+    double mean = std::accumulate(ms.begin(), ms.end(), 0.0) / ms.size();
+    out << "      \"runs_ms\": [";
+    for (size_t i = 0; i < ms.size(); ++i) {
+        out << (i == 0 ? "" : ", ") << ms[i];
+    }
+    out << "],\n"
+        << "      \"summary\": {\"ms_mean\": " << mean
+        << ", \"ms_min\": " << *std::min_element(ms.begin(), ms.end())
+        << ", \"ms_p95\": " << percentile(ms, 0.95) << "}";
+}
+
+CoreBenchmark::CoreBenchmark(const CoreBenchmarkOptions &options)
+    : m_options(options), m_failed(false)
+{}
+
+int CoreBenchmark::worldMin() const
+{
+    return 0;
+}
+
+int CoreBenchmark::worldMax() const
+{
+    return 64 * m_options.zones;
+}
+
+void CoreBenchmark::generateWorld(Terrain *terrain, int biomeStep) const
+{
+    terrain->setSeed(m_options.seed);
+    terrain->setBiomeSampling(biomeStep > 0 ? biomeStep : m_options.biomeStep, m_options.biomeError);
+    for (int x = worldMin(); x < worldMax(); x += 64) {
+        for (int z = worldMin(); z < worldMax(); z += 64) {
+            terrain->generateTerrain(x, z);
+        }
+    }
+}
+
+void CoreBenchmark::runGeneration(std::ostream &out)
+{
+    std::vector<double> ms, msExact, msThreaded, msNoCaves;
+    ThreadPool threads;
+    Terrain terrain;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        // Keep the first world to check its biomes
+        Terrain repetition;
+        Terrain *sampled = r == 0 ? &terrain : &repetition;
+        Clock::time_point start = Clock::now();
+        generateWorld(sampled);
+        ms.push_back(msSince(start));
+
+        // The same world with every biome weight evaluated exactly
+        Terrain exact;
+        start = Clock::now();
+        generateWorld(&exact, 1);
+        msExact.push_back(msSince(start));
+
+        // And with the per-Chunk stages spread over every core
+        Terrain threaded;
+        threaded.setThreadPool(&threads);
+        start = Clock::now();
+        generateWorld(&threaded);
+        msThreaded.push_back(msSince(start));
+
+        // And with nothing carved out of the ground
+        Terrain noCaves;
+        noCaves.setCavesEnabled(false);
+        start = Clock::now();
+        generateWorld(&noCaves);
+        msNoCaves.push_back(msSince(start));
+    }
+
+    // Check the interpolated biome weights against the exact ones
+    int columns = worldMax() * worldMax();
+    double maxError = 0.0, sumError = 0.0;
+    for (int x = worldMin(); x < worldMax(); ++x) {
+        for (int z = worldMin(); z < worldMax(); ++z) {
+            double error = std::abs(terrain.biomeWeight(x, z) - terrain.heightMapBiome(x, z));
+            maxError = std::max(maxError, error);
+            sumError += error;
+        }
+    }
+
+    // The biome noise on its own, which is all the sampling step changes:
+    // the biome weights of every Chunk, sampled coarsely and exactly
+    std::vector<double> biomeMs, biomeExactMs;
+    Terrain coarseBiomes, exactBiomes;
+    coarseBiomes.setSeed(m_options.seed);
+    coarseBiomes.setBiomeSampling(m_options.biomeStep, m_options.biomeError);
+    exactBiomes.setSeed(m_options.seed);
+    exactBiomes.setBiomeSampling(1, m_options.biomeError);
+    std::array<float, 16 * 16> weights;
+    volatile float biomeSink = 0.f;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        for (Terrain *t : {&coarseBiomes, &exactBiomes}) {
+            Clock::time_point start = Clock::now();
+            for (int x = worldMin(); x < worldMax(); x += 16) {
+                for (int z = worldMin(); z < worldMax(); z += 16) {
+                    t->fillBiomeWeights(x, z, weights.data());
+                    biomeSink = biomeSink + weights[0];
+                }
+            }
+            (t == &coarseBiomes ? biomeMs : biomeExactMs).push_back(msSince(start));
+        }
+    }
+    int zones = m_options.zones * m_options.zones;
+    double biomeZoneMs = *std::min_element(biomeMs.begin(), biomeMs.end()) / zones;
+    double biomeExactZoneMs = *std::min_element(biomeExactMs.begin(), biomeExactMs.end()) / zones;
+
+    // How much of the ground the caves hollowed out
+    long long underground = 0, hollow = 0;
+    for (int x = worldMin(); x < worldMax(); ++x) {
+        for (int z = worldMin(); z < worldMax(); ++z) {
+            const Chunk *c = terrain.findChunkAt(x, z);
+            glm::ivec2 origin = c->getOrigin();
+            int ground = c->getTerrainHeight(x - origin.x, z - origin.y);
+            for (int y = 0; y < ground; ++y) {
+                hollow += c->isEmptyAt(x - origin.x, y, z - origin.y);
+            }
+            underground += ground;
+        }
+    }
+
+    double best = *std::min_element(ms.begin(), ms.end());
+    double bestExact = *std::min_element(msExact.begin(), msExact.end());
+    double bestThreaded = *std::min_element(msThreaded.begin(), msThreaded.end());
+    double bestNoCaves = *std::min_element(msNoCaves.begin(), msNoCaves.end());
+    std::cerr << "generation: " << best << " ms for " << m_options.zones * m_options.zones
+              << " zones (" << bestExact << " ms with exact biomes, " << bestThreaded << " ms on "
+              << threads.threadCount() << " threads, " << bestNoCaves << " ms without caves)" << std::endl;
+    std::cerr << "generation: biome weights take " << biomeZoneMs << " ms per zone sampled every "
+              << m_options.biomeStep << " blocks (" << biomeExactZoneMs << " ms exactly)" << std::endl;
+    // Generation only samples the error at a few points of each lattice
+    // cell, so this is what holds every column to the bound
+    if (maxError > m_options.biomeError) {
+        std::cerr << "Interpolated biome weights exceed the error bound: " << maxError << " > "
+                  << m_options.biomeError << std::endl;
+        m_failed = true;
+    }
+
+    out << "    {\n"
+        << "      \"suite\": \"generation\",\n"
+        << "      \"zones\": " << m_options.zones * m_options.zones << ",\n"
+        << "      \"columns\": " << columns << ",\n"
+        << "      \"biome_step\": " << m_options.biomeStep << ",\n";
+    writeTimes(out, ms);
+    out << ",\n"
+        << "      \"us_per_column_min\": " << 1000.0 * best / columns << ",\n"
+        << "      \"exact_biome_ms_min\": " << bestExact << ",\n"
+        << "      \"biome_weights_ms_per_zone_min\": " << biomeZoneMs << ",\n"
+        << "      \"exact_biome_weights_ms_per_zone_min\": " << biomeExactZoneMs << ",\n"
+        << "      \"threads\": " << threads.threadCount() << ",\n"
+        << "      \"threaded_ms_min\": " << bestThreaded << ",\n"
+        << "      \"no_caves_ms_min\": " << bestNoCaves << ",\n"
+        << "      \"cave_fraction\": " << static_cast<double>(hollow) / underground << ",\n"
+        << "      \"biome_error_max\": " << maxError << ",\n"
+        << "      \"biome_error_mean\": " << sumError / columns << ",\n"
+        << "      \"biome_error_bound\": " << m_options.biomeError << "\n"
+        << "    }";
+}
+
+// The mesh every ChunkDrawable kept before meshes were built into a
+// per-thread scratch ChunkMesh, grown one float at a time
+struct LegacyMesh {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<float> verticesTransparent;
+    std::vector<unsigned int> indicesTransparent;
+};
+
+static void legacyAddFace(std::vector<float> &buffer, std::vector<unsigned int> &idx, glm::ivec3 pos,
+                          const Direction *d, glm::vec4 color, glm::vec2 uv, glm::vec2 light, const std::array<int, 4> &ao)
+{
+    unsigned int initial = buffer.size() / ChunkMesh::FLOATS_PER_VERTEX;
+    for (int i = 0; i < 4; i++) {
+        const VertexInfo &v = d->vertices[i];
+        glm::vec4 p = v.pos + glm::vec4(pos, 0);
+        glm::vec2 vertexUV = uv + v.uv;
+        for (float f : {p.x, p.y, p.z, p.w, float(d->vector.x), float(d->vector.y), float(d->vector.z), 1.f,
+                        color.r, color.g, color.b, color.a, vertexUV.x, vertexUV.y, light.x, light.y}) {
+            buffer.push_back(f);
+        }
+        buffer.push_back(ao[i] / 3.f);
+    }
+    unsigned int first = ao[0] + ao[2] >= ao[1] + ao[3] ? initial : initial + 1;
+    for (unsigned int i = 0; i < 2; i++) {
+        idx.push_back(first);
+        idx.push_back(initial + (first - initial + i + 1) % 4);
+        idx.push_back(initial + (first - initial + i + 2) % 4);
+    }
+}
+
+// How Chunk::createMeshData built meshes before it counted the visible
+// faces and stored straight into a MeshBuffer. Kept here only to compare
+// costs and results against. It shades faces with the same faceAO and
+// faceLight as Chunk, so only the culling and vertex writes are compared.
+static void legacyCreateMeshData(const Chunk *chunk, LegacyMesh *mesh)
+{
+    mesh->vertices.clear();
+    mesh->indices.clear();
+    mesh->verticesTransparent.clear();
+    mesh->indicesTransparent.clear();
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 256; y++) {
+            for (int z = 0; z < 16; z++) {
+                glm::ivec3 pos(x, y, z);
+                BlockType b = chunk->getBlockAt(pos);
+                if (b.isOpaque()) {
+                    for (auto d : Direction::all) {
+                        if (!chunk->getBlockAt(pos + d->vector).isOpaque()) {
+                            legacyAddFace(mesh->vertices, mesh->indices, pos, d, glm::vec4(b.getColor(), 1),
+                                          b.getUV(d->vector), faceLight(chunk, pos, d, b), faceAO(chunk, pos, d));
+                        }
+                    }
+                } else if (b.isTranslucent()) {
+                    for (auto d : Direction::all) {
+                        BlockType neighbor = chunk->getBlockAt(pos + d->vector);
+                        if (!neighbor.isOpaque() && neighbor != b) {
+                            legacyAddFace(mesh->verticesTransparent, mesh->indicesTransparent, pos, d,
+                                          glm::vec4(b.getColor(), b.getAlpha()), b.getUV(d->vector),
+                                          faceLight(chunk, pos, d, b), faceAO(chunk, pos, d));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// How Chunk::findVisibleFaces found the visible faces before it used
+// column masks: up to six getBlockAt calls per block. Kept here only to
+// compare costs and results against.
+static void legacyFindVisibleFaces(const Chunk *chunk, uint8_t *visible)
+{
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 256; y++) {
+            for (int z = 0; z < 16; z++) {
+                glm::ivec3 pos(x, y, z);
+                BlockType b = chunk->getBlockAt(pos);
+                uint8_t faces = 0;
+                if (b.isOpaque() || b.isTranslucent()) {
+                    for (size_t i = 0; i < Direction::all.size(); i++) {
+                        BlockType neighbor = chunk->getBlockAt(pos + Direction::all[i]->vector);
+                        if (!neighbor.isOpaque() && (b.isOpaque() || neighbor != b)) {
+                            faces |= 1 << i;
+                        }
+                    }
+                }
+                visible[x + 16 * y + 16 * 256 * z] = faces;
+            }
+        }
+    }
+}
+
+// The vertices of every triangle of a legacy mesh, in drawing order
+static std::vector<float> legacyTriangles(const std::vector<float> &vertices, const std::vector<unsigned int> &indices)
+{
+    std::vector<float> out;
+    for (unsigned int i : indices) {
+        const float *v = &vertices[i * ChunkMesh::FLOATS_PER_VERTEX];
+        out.insert(out.end(), v, v + ChunkMesh::FLOATS_PER_VERTEX);
+    }
+    return out;
+}
+
+// The same for a ChunkMesh, drawn with the shared quad indices
+static std::vector<float> quadTriangles(const MeshBuffer<float> &vertices)
+{
+    std::vector<float> out;
+    for (size_t face = 0; face < vertices.size() / ChunkMesh::FLOATS_PER_FACE; face++) {
+        for (int corner : {0, 1, 2, 0, 2, 3}) {
+            const float *v = vertices.data() + face * ChunkMesh::FLOATS_PER_FACE + corner * ChunkMesh::FLOATS_PER_VERTEX;
+            out.insert(out.end(), v, v + ChunkMesh::FLOATS_PER_VERTEX);
+        }
+    }
+    return out;
+}
+
+void CoreBenchmark::runMeshing(std::ostream &out)
+{
+    Terrain terrain;
+    generateWorld(&terrain);
+    std::vector<Chunk*> chunks = terrain.getChunksFrontToBack(worldMin(), worldMax(), worldMin(), worldMax(),
+                                                              glm::vec3(0.f));
+
+    // The scratch mesh grows to fit during a first, unmeasured pass,
+    // after which re-meshing shouldn't allocate at all
+    ChunkMesh mesh;
+    for (Chunk *c : chunks) {
+        c->createMeshData(&mesh);
+    }
+    int warmupAllocations = mesh.allocations;
+
+    size_t triangles = 0, trianglesTransparent = 0;
+    int maxFaces = 0;
+    std::vector<double> ms, legacyMs, freshMs;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        triangles = trianglesTransparent = 0;
+        Clock::time_point start = Clock::now();
+        for (Chunk *c : chunks) {
+            c->createMeshData(&mesh);
+            triangles += 2 * mesh.faceCount();
+            trianglesTransparent += 2 * mesh.faceCountTransparent();
+            maxFaces = std::max(maxFaces, std::max(mesh.faceCount(), mesh.faceCountTransparent()));
+        }
+        ms.push_back(msSince(start));
+    }
+    int steadyAllocations = mesh.allocations - warmupAllocations;
+
+    // Face culling on its own, with column masks and block by block
+    std::vector<double> cullMs, legacyCullMs;
+    std::vector<uint8_t> legacyVisible(65536);
+    for (int r = 0; r < m_options.repeat; ++r) {
+        size_t opaqueFaces, translucentFaces;
+        Clock::time_point start = Clock::now();
+        for (Chunk *c : chunks) {
+            mesh.clear();
+            c->findVisibleFaces(&mesh, &opaqueFaces, &translucentFaces);
+        }
+        cullMs.push_back(msSince(start));
+
+        start = Clock::now();
+        for (Chunk *c : chunks) {
+            legacyFindVisibleFaces(c, legacyVisible.data());
+        }
+        legacyCullMs.push_back(msSince(start));
+    }
+    int cullMismatches = 0;
+    for (Chunk *c : chunks) {
+        size_t opaqueFaces, translucentFaces;
+        mesh.clear();
+        c->findVisibleFaces(&mesh, &opaqueFaces, &translucentFaces);
+        legacyFindVisibleFaces(c, legacyVisible.data());
+        cullMismatches += !std::equal(legacyVisible.begin(), legacyVisible.end(), mesh.visibleFaces.data());
+    }
+
+    // The legacy mesher into one reused mesh, and into a new one per
+    // Chunk, as the first mesh of every ChunkDrawable was
+    LegacyMesh legacy;
+    size_t legacyBytes = 0;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        Clock::time_point start = Clock::now();
+        for (Chunk *c : chunks) {
+            legacyCreateMeshData(c, &legacy);
+        }
+        legacyMs.push_back(msSince(start));
+
+        start = Clock::now();
+        legacyBytes = 0;
+        for (Chunk *c : chunks) {
+            LegacyMesh fresh;
+            legacyCreateMeshData(c, &fresh);
+            legacyBytes += (fresh.vertices.capacity() + fresh.verticesTransparent.capacity()) * sizeof(float) +
+                           (fresh.indices.capacity() + fresh.indicesTransparent.capacity()) * sizeof(unsigned int);
+        }
+        freshMs.push_back(msSince(start));
+    }
+    size_t scratchBytes = (mesh.vertices.capacity() + mesh.verticesTransparent.capacity()) * sizeof(float) +
+                          mesh.visibleFaces.capacity();
+
+    // Every Chunk once uploaded its own 32-bit indices. Now they share one
+    // buffer of 16-bit indices, plus a 32-bit one if any mesh is too big,
+    // each only as large as the biggest mesh that needed it.
+    size_t perChunkIndexBytes = 3 * (triangles + trianglesTransparent) * sizeof(uint32_t);
+    size_t sharedIndexBytes = QuadIndices::byteSize(maxFaces);
+
+    // The meshes have to draw the same triangles, though the faces that
+    // are split along their other diagonal now start at another vertex
+    int mismatches = 0;
+    for (Chunk *c : chunks) {
+        c->createMeshData(&mesh);
+        legacyCreateMeshData(c, &legacy);
+        mismatches += legacyTriangles(legacy.vertices, legacy.indices) != quadTriangles(mesh.vertices) ||
+                      legacyTriangles(legacy.verticesTransparent, legacy.indicesTransparent) !=
+                      quadTriangles(mesh.verticesTransparent);
+    }
+    if (mismatches > 0) {
+        std::cerr << mismatches << " Chunks mesh differently than with the legacy mesher" << std::endl;
+        m_failed = true;
+    }
+    if (cullMismatches > 0) {
+        std::cerr << cullMismatches << " Chunks have different visible faces with column masks" << std::endl;
+        m_failed = true;
+    }
+    if (steadyAllocations > 0) {
+        std::cerr << "Re-meshing allocated " << steadyAllocations << " times after warming up" << std::endl;
+        m_failed = true;
+    }
+
+    double best = *std::min_element(ms.begin(), ms.end());
+    double legacyBest = *std::min_element(legacyMs.begin(), legacyMs.end());
+    double freshBest = *std::min_element(freshMs.begin(), freshMs.end());
+    double cullBest = *std::min_element(cullMs.begin(), cullMs.end());
+    double legacyCullBest = *std::min_element(legacyCullMs.begin(), legacyCullMs.end());
+    std::cerr << "meshing: " << best << " ms for " << chunks.size() << " chunks (" << legacyBest
+              << " ms with push_back, " << freshBest << " ms into new vectors), " << steadyAllocations
+              << " allocations after warmup; " << sharedIndexBytes << " bytes of shared indices instead of "
+              << perChunkIndexBytes << " per Chunk" << std::endl;
+    std::cerr << "meshing: face culling " << 1000.0 * cullBest / chunks.size() << " us per chunk ("
+              << 1000.0 * legacyCullBest / chunks.size() << " us block by block)" << std::endl;
+
+    out << "    {\n"
+        << "      \"suite\": \"meshing\",\n"
+        << "      \"chunks\": " << chunks.size() << ",\n"
+        << "      \"triangles\": " << triangles << ",\n"
+        << "      \"triangles_translucent\": " << trianglesTransparent << ",\n";
+    writeTimes(out, ms);
+    out << ",\n"
+        << "      \"us_per_chunk_min\": " << 1000.0 * best / chunks.size() << ",\n"
+        << "      \"legacy_us_per_chunk_min\": " << 1000.0 * legacyBest / chunks.size() << ",\n"
+        << "      \"legacy_fresh_us_per_chunk_min\": " << 1000.0 * freshBest / chunks.size() << ",\n"
+        << "      \"cull_us_per_chunk_min\": " << 1000.0 * cullBest / chunks.size() << ",\n"
+        << "      \"legacy_cull_us_per_chunk_min\": " << 1000.0 * legacyCullBest / chunks.size() << ",\n"
+        << "      \"cull_mismatches\": " << cullMismatches << ",\n"
+        << "      \"warmup_allocations\": " << warmupAllocations << ",\n"
+        << "      \"steady_allocations\": " << steadyAllocations << ",\n"
+        << "      \"scratch_bytes\": " << scratchBytes << ",\n"
+        << "      \"max_faces_per_mesh\": " << maxFaces << ",\n"
+        << "      \"per_chunk_index_bytes\": " << perChunkIndexBytes << ",\n"
+        << "      \"shared_index_bytes\": " << sharedIndexBytes << ",\n"
+        << "      \"legacy_retained_bytes\": " << legacyBytes << ",\n"
+        << "      \"mismatches\": " << mismatches << "\n"
+        << "    }";
+}
+
+void CoreBenchmark::runRaycast(std::ostream &out)
+{
+    Terrain terrain;
+    generateWorld(&terrain);
+
+    out << "    {\n"
+        << "      \"suite\": \"raycast\",\n"
+        << "      \"rays\": " << m_options.rays << ",\n"
+        << "      \"lengths\": [\n";
+    runRaycast(out, terrain, "short", m_options.shortRay);
+    out << ",\n";
+    runRaycast(out, terrain, "long", m_options.longRay);
+    out << "\n      ]\n"
+        << "    }";
+}
+
+// Casts the same random rays of the given length with gridMarch, with
+// one Terrain::raycast call per ray and with a single batched call
+void CoreBenchmark::runRaycast(std::ostream &out, const Terrain &terrain, const char *name, float length)
+{
+    // Rays start anywhere in the world, a bit above the lowest ground,
+    // and may leave it (where they end without a hit)
+    std::mt19937 rng(m_options.seed);
+    std::uniform_real_distribution<float> horizontal(worldMin(), worldMax());
+    std::uniform_real_distribution<float> vertical(100.f, 220.f);
+    std::normal_distribution<float> gaussian;
+
+    const int rays = m_options.rays;
+    std::vector<glm::vec3> origins(rays), directions(rays);
+    std::vector<float> lengths(rays, length);
+    for (int i = 0; i < rays; ++i) {
+        origins[i] = glm::vec3(horizontal(rng), vertical(rng), horizontal(rng));
+        glm::vec3 d(gaussian(rng), gaussian(rng), gaussian(rng));
+        directions[i] = glm::normalize(d + glm::vec3(0, 0, 1e-6f));
+    }
+
+    std::vector<RayHit> hits(rays);
+    std::vector<char> marchHit(rays);
+    std::vector<float> marchDist(rays), marchAxis(rays);
+    std::vector<glm::ivec3> marchBlock(rays);
+    int gridMarchHits = 0, singleHits = 0, batchHits = 0;
+    std::vector<double> gridMarchMs, singleMs, batchMs;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        float dist = 0, axis = 0;
+        glm::ivec3 blockHit;
+        gridMarchHits = 0;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < rays; ++i) {
+            gridMarchHits += terrain.gridMarch(origins[i], directions[i] * length, &dist, &blockHit, &axis);
+        }
+        gridMarchMs.push_back(msSince(start));
+        if (r == 0) {
+            for (int i = 0; i < rays; ++i) {
+                marchHit[i] = terrain.gridMarch(origins[i], directions[i] * length, &marchDist[i], &marchBlock[i], &marchAxis[i]);
+            }
+        }
+
+        singleHits = 0;
+        start = Clock::now();
+        for (int i = 0; i < rays; ++i) {
+            singleHits += terrain.raycast(origins[i], directions[i], length).hit;
+        }
+        singleMs.push_back(msSince(start));
+
+        batchHits = 0;
+        start = Clock::now();
+        terrain.raycast(origins.data(), directions.data(), lengths.data(), rays, hits.data());
+        batchMs.push_back(msSince(start));
+        for (const RayHit &h : hits) {
+            batchHits += h.hit;
+        }
+    }
+
+    auto raysPerSecond = [&](const std::vector<double> &ms) {
+        return rays / (*std::min_element(ms.begin(), ms.end()) / 1000.0);
+    };
+    std::cerr << "raycast (" << name << ", " << length << " blocks): "
+              << raysPerSecond(gridMarchMs) / 1e6 << " M rays/s with gridMarch, "
+              << raysPerSecond(singleMs) / 1e6 << " M one at a time, "
+              << raysPerSecond(batchMs) / 1e6 << " M batched" << std::endl;
+
+    // Picking casts one ray at a time, so that has to stay ahead of the
+    // gridMarch it replaced
+    if (raysPerSecond(singleMs) < raysPerSecond(gridMarchMs)) {
+        std::cerr << "Terrain::raycast is slower than gridMarch" << std::endl;
+        m_failed = true;
+    }
+    if (singleHits != batchHits) {
+        std::cerr << "Batched and single raycasts disagree: " << batchHits << " vs " << singleHits << " hits" << std::endl;
+        m_failed = true;
+    }
+
+    // Every batched ray must hit the same block as gridMarch, through the
+    // same face and at the same distance, up to the rounding of their sums.
+    // A ray passing within rounding of a block's edge or corner may enter
+    // either block beside it first; those are counted as ties.
+    int mismatches = 0, ties = 0;
+    for (int i = 0; i < rays; ++i) {
+        const RayHit &h = hits[i];
+        bool same = h.hit == static_cast<bool>(marchHit[i]) && glm::abs(h.distance - marchDist[i]) < 1e-3f;
+        if (same && h.hit) {
+            glm::ivec3 apart = glm::abs(h.block - marchBlock[i]);
+            if (h.block != marchBlock[i] && glm::max(apart.x, glm::max(apart.y, apart.z)) == 1 &&
+                glm::abs(h.distance - marchDist[i]) < 1e-4f) {
+                ties++;
+                continue;
+            }
+            same = h.block == marchBlock[i] && h.normal[static_cast<int>(marchAxis[i])] != 0;
+        }
+        if (!same && mismatches < 5) {
+            std::cerr << "  ray " << i << ": batched " << h.hit << " (" << h.block.x << ", " << h.block.y << ", " << h.block.z
+                      << ") at " << h.distance << ", gridMarch " << static_cast<int>(marchHit[i]) << " (" << marchBlock[i].x << ", "
+                      << marchBlock[i].y << ", " << marchBlock[i].z << ") at " << marchDist[i] << std::endl;
+        }
+        mismatches += !same;
+    }
+    if (mismatches > 0) {
+        std::cerr << "Batched raycasts disagree with gridMarch for " << mismatches << " rays" << std::endl;
+        m_failed = true;
+    }
+
+    out << "        {\"name\": \"" << name << "\", \"length\": " << length
+        << ", \"hits\": " << batchHits << ", \"grid_march_hits\": " << gridMarchHits
+        << ",\n         \"rays_per_second\": {\"grid_march\": " << raysPerSecond(gridMarchMs)
+        << ", \"single\": " << raysPerSecond(singleMs)
+        << ", \"batched\": " << raysPerSecond(batchMs) << "},\n"
+        << "         \"grid_march_mismatches\": " << mismatches << ", \"grid_march_ties\": " << ties << "}";
+}
+
+// One simulated entity of the collision suite
+struct BenchEntity {
+    glm::vec3 position; // Bottom center of its box
+    glm::vec3 velocity; // Blocks per tick
+    glm::vec3 halfSize;
+    bool onGround;
+
+    AABB box() const {
+        return AABB(position - glm::vec3(halfSize.x, 0, halfSize.z),
+                    position + glm::vec3(halfSize.x, 2 * halfSize.y, halfSize.z));
+    }
+};
+
+// The collision test Player used before Collision::sweep: rays cast
+// from 12 points on a 0.8 x 1.9 box along each axis, up to 36 grid
+// marches per tick. Kept here only to compare costs against.
+static glm::vec3 rayCollision(const Terrain &terrain, glm::vec3 position, glm::vec3 movement)
+{
+    float minDist[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float dist = 0, axis = 0;
+    glm::ivec3 blockHit;
+    glm::vec3 start = position - glm::vec3(0.5f, 0.f, 0.5f);
+    for (float x = 0.1f; x <= 1; x += 0.8f) {
+        for (float z = 0.1f; z <= 1; z += 0.8f) {
+            for (float y = 0.1f; y <= 1.9f; y += 0.9f) {
+                for (int i = 0; i < 3; ++i) {
+                    glm::vec3 ray(0.f);
+                    ray[i] = movement[i];
+                    if (ray[i] != 0 && terrain.gridMarch(start + glm::vec3(x, y, z), ray, &dist, &blockHit, &axis)) {
+                        minDist[i] = glm::min(minDist[i], dist);
+                    }
+                }
+            }
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (minDist[i] != FLT_MAX) {
+            movement[i] = glm::sign(movement[i]) * minDist[i];
+        }
+    }
+    return movement;
+}
+
+// Walks an entity through a small hand-built world for the given number
+// of ticks, with the benchmark's gravity, hopping whenever it walks into
+// something while standing on the ground
+struct WalkResult {
+    BenchEntity entity;
+    bool everBlocked[3]; // Whether a block ever stopped it along each axis
+    int groundedTicks;
+};
+
+static WalkResult walk(const Terrain &terrain, BenchEntity e, int ticks)
+{
+    WalkResult walked{e, {false, false, false}, 0};
+    for (int t = 0; t < ticks; ++t) {
+        e.velocity.y = glm::max(e.velocity.y - 0.08f, -2.f);
+        CollisionResult result = Collision::sweep(terrain, e.box(), e.velocity);
+        e.position += result.movement;
+        e.onGround = result.onGround;
+        if (result.blocked[1]) {
+            e.velocity.y = 0;
+        }
+        if (e.onGround && (result.blocked[0] || result.blocked[2])) {
+            // Rises about 1.3 blocks, enough to clear one
+            e.velocity.y = 0.5f;
+        }
+        for (int i = 0; i < 3; ++i) {
+            walked.everBlocked[i] = walked.everBlocked[i] || result.blocked[i];
+        }
+        walked.groundedTicks += e.onGround;
+    }
+    walked.entity = e;
+    return walked;
+}
+
+// Checks Collision::sweep against situations with known outcomes, in a
+// single Chunk with a stone floor at y = 0. Returns the failed checks.
+static std::vector<std::string> checkCollisionCases()
+{
+    Terrain terrain;
+    terrain.instantiateChunkAt(0, 0);
+    auto fill = [&](glm::ivec3 lo, glm::ivec3 hi) {
+        for (int x = lo.x; x <= hi.x; ++x) {
+            for (int y = lo.y; y <= hi.y; ++y) {
+                for (int z = lo.z; z <= hi.z; ++z) {
+                    terrain.setBlockAt(x, y, z, BlockType::STONE);
+                }
+            }
+        }
+    };
+    fill(glm::ivec3(0, 0, 0), glm::ivec3(15, 0, 15));
+    // A wall across z 1 to 4 with a doorway one block wide and two tall at z = 2
+    fill(glm::ivec3(8, 1, 1), glm::ivec3(8, 3, 4));
+    terrain.setBlockAt(8, 1, 2, BlockType::EMPTY);
+    terrain.setBlockAt(8, 2, 2, BlockType::EMPTY);
+    // A solid wall across z 5 to 10, meeting another along x at z = 10,
+    // and a pillar three blocks tall behind it
+    fill(glm::ivec3(8, 1, 5), glm::ivec3(8, 3, 10));
+    fill(glm::ivec3(4, 1, 10), glm::ivec3(7, 3, 10));
+    fill(glm::ivec3(12, 1, 7), glm::ivec3(12, 3, 7));
+    // A step one block high across z 11 to 14
+    fill(glm::ivec3(8, 1, 11), glm::ivec3(14, 1, 14));
+
+    // Player sized: 0.6 wide and 1.8 tall, walking along +x on the floor
+    auto entity = [](glm::vec3 position, glm::vec3 velocity) {
+        return BenchEntity{position, velocity, glm::vec3(0.3f, 0.9f, 0.3f), false};
+    };
+    const float tolerance = 1e-3f;
+    std::vector<std::string> failed;
+    auto check = [&](bool ok, const char *name) {
+        if (!ok) {
+            failed.push_back(name);
+        }
+    };
+
+    WalkResult door = walk(terrain, entity(glm::vec3(3.f, 1.f, 2.5f), glm::vec3(0.15f, 0.f, 0.f)), 60);
+    check(door.entity.position.x > 10.f && !door.everBlocked[0] && !door.everBlocked[2],
+          "walks through a 1 x 2 doorway");
+    check(glm::abs(door.entity.position.y - 1.f) < tolerance && door.groundedTicks == 60,
+          "stays on the ground across block seams");
+
+    WalkResult wall = walk(terrain, entity(glm::vec3(3.f, 1.f, 7.5f), glm::vec3(0.15f, 0.f, 0.f)), 60);
+    check(wall.everBlocked[0] && glm::abs(wall.entity.box().max.x - 8.f) < tolerance,
+          "stops flush against a wall");
+
+    WalkResult slide = walk(terrain, entity(glm::vec3(3.f, 1.f, 5.5f), glm::vec3(0.15f, 0.f, 0.05f)), 60);
+    check(glm::abs(slide.entity.box().max.x - 8.f) < tolerance &&
+          glm::abs(slide.entity.position.z - 8.5f) < tolerance && !slide.everBlocked[2],
+          "slides along a wall it walks into at an angle");
+
+    // Dropped onto the pillar's top with only 0.01 of the box over its
+    // edge, then dropped just clear of it
+    WalkResult edge = walk(terrain, entity(glm::vec3(13.29f, 6.f, 7.5f), glm::vec3(0.f)), 60);
+    check(edge.entity.onGround && glm::abs(edge.entity.position.y - 4.f) < tolerance,
+          "lands on the edge of a block");
+    WalkResult clear = walk(terrain, entity(glm::vec3(13.31f, 6.f, 7.5f), glm::vec3(0.f)), 60);
+    check(clear.entity.onGround && glm::abs(clear.entity.position.y - 1.f) < tolerance && !clear.everBlocked[0],
+          "falls past the edge of a block without catching on its side");
+
+    WalkResult step = walk(terrain, entity(glm::vec3(3.f, 1.f, 12.5f), glm::vec3(0.15f, 0.f, 0.f)), 60);
+    check(step.entity.onGround && glm::abs(step.entity.position.y - 2.f) < tolerance &&
+          step.entity.position.x > 10.f, "hops up onto a step");
+
+    // Into the corner where the two walls meet, where it must end up
+    // flush against both without sinking into either
+    WalkResult corner = walk(terrain, entity(glm::vec3(6.f, 1.f, 8.f), glm::vec3(0.1f, 0.f, 0.1f)), 60);
+    AABB box = corner.entity.box();
+    check(glm::abs(box.max.x - 8.f) < tolerance && glm::abs(box.max.z - 10.f) < tolerance,
+          "stops in an inside corner");
+    return failed;
+}
+
+void CoreBenchmark::runCollision(std::ostream &out)
+{
+    std::vector<std::string> failedCases = checkCollisionCases();
+    for (const std::string &name : failedCases) {
+        std::cerr << "Collision check failed: " << name << std::endl;
+        m_failed = true;
+    }
+
+    Terrain terrain;
+    generateWorld(&terrain);
+
+    // Entities of assorted sizes dropped just above the ground, each walking
+    // in a random direction, jumping now and then and turning around at
+    // walls and at the edges of the world
+    std::mt19937 rng(m_options.seed);
+    const float margin = 8.f;
+    std::uniform_real_distribution<float> horizontal(worldMin() + margin, worldMax() - margin);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    std::vector<BenchEntity> initial(m_options.entities);
+    for (BenchEntity &e : initial) {
+        e.position = glm::vec3(horizontal(rng), 0.f, horizontal(rng));
+        int y = glm::max(terrain.surfaceHeight(glm::floor(e.position.x), glm::floor(e.position.z)), 0);
+        e.position.y = y + 1.5f;
+        float angle = glm::radians(360.f) * unit(rng);
+        float speed = 0.05f + 0.25f * unit(rng);
+        e.velocity = glm::vec3(glm::cos(angle), 0.f, glm::sin(angle)) * speed;
+        e.halfSize = glm::vec3(0.3f + 0.4f * unit(rng), 0.4f + 0.55f * unit(rng), 0.f);
+        e.halfSize.z = e.halfSize.x;
+        e.onGround = false;
+    }
+
+    // Each repetition replays the same ticks from the same starting state
+    auto simulate = [&](bool legacy, int *groundedTicks) {
+        std::vector<BenchEntity> entities = initial;
+        std::mt19937 jumps(m_options.seed);
+        *groundedTicks = 0;
+        Clock::time_point start = Clock::now();
+        for (int t = 0; t < m_options.ticks; ++t) {
+            for (BenchEntity &e : entities) {
+                e.velocity.y = glm::max(e.velocity.y - 0.08f, -2.f);
+                if (e.onGround && unit(jumps) < 0.05f) {
+                    e.velocity.y = 0.42f;
+                }
+                for (int i : {0, 2}) {
+                    if ((e.position[i] < worldMin() + margin && e.velocity[i] < 0) ||
+                        (e.position[i] > worldMax() - margin && e.velocity[i] > 0)) {
+                        e.velocity[i] = -e.velocity[i];
+                    }
+                }
+
+                glm::vec3 moved;
+                if (legacy) {
+                    moved = rayCollision(terrain, e.position, e.velocity);
+                    e.onGround = e.velocity.y < 0 && moved.y > e.velocity.y;
+                } else {
+                    CollisionResult result = Collision::sweep(terrain, e.box(), e.velocity);
+                    moved = result.movement;
+                    e.onGround = result.onGround;
+                    if (result.blocked[0]) e.velocity.x = -e.velocity.x;
+                    if (result.blocked[1]) e.velocity.y = 0;
+                    if (result.blocked[2]) e.velocity.z = -e.velocity.z;
+                }
+                e.position += moved;
+                *groundedTicks += e.onGround;
+            }
+        }
+        return msSince(start);
+    };
+
+    int grounded = 0, legacyGrounded = 0;
+    std::vector<double> ms, legacyMs;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        ms.push_back(simulate(false, &grounded));
+        legacyMs.push_back(simulate(true, &legacyGrounded));
+    }
+
+    double entityTicks = static_cast<double>(m_options.entities) * m_options.ticks;
+    double best = *std::min_element(ms.begin(), ms.end());
+    double legacyBest = *std::min_element(legacyMs.begin(), legacyMs.end());
+    std::cerr << "collision: " << 1e6 * best / entityTicks << " ns per entity per tick (ray casting: "
+              << 1e6 * legacyBest / entityTicks << " ns)" << std::endl;
+
+    out << "    {\n"
+        << "      \"suite\": \"collision\",\n"
+        << "      \"entities\": " << m_options.entities << ",\n"
+        << "      \"ticks\": " << m_options.ticks << ",\n"
+        << "      \"grounded_fraction\": " << grounded / entityTicks << ",\n"
+        << "      \"checks_failed\": " << failedCases.size() << ",\n";
+    writeTimes(out, ms);
+    out << ",\n"
+        << "      \"ns_per_entity_tick_min\": " << 1e6 * best / entityTicks << ",\n"
+        << "      \"ray_casting_ns_per_entity_tick_min\": " << 1e6 * legacyBest / entityTicks << "\n"
+        << "    }";
+}
+
+void CoreBenchmark::runMobs(std::ostream &out)
+{
+    Terrain terrain;
+    generateWorld(&terrain);
+
+    float half = 0.5f * (worldMax() - worldMin());
+    glm::vec3 center(worldMin() + half, 0.f, worldMin() + half);
+    ThreadPool threads;
+
+    // Each repetition replays the same ticks from the same starting
+    // state, once on the calling thread and once on the ThreadPool
+    std::vector<double> serialTicks, parallelTicks;
+    int spawned = 0, grounded = 0;
+    auto simulate = [&](ThreadPool *pool, std::vector<double> *tickMs) {
+        MobSystem mobs(pool);
+        spawned = mobs.spawnWanderers(terrain, center, half - 8.f, m_options.mobCount, m_options.seed);
+        for (int t = 0; t < m_options.ticks; ++t) {
+            Clock::time_point start = Clock::now();
+            mobs.tick(1.f / 60.f, terrain);
+            tickMs->push_back(msSince(start));
+        }
+        grounded = 0;
+        for (int i = 0; i < mobs.size(); ++i) {
+            grounded += mobs.isOnGround(i);
+        }
+    };
+    for (int r = 0; r < m_options.repeat; ++r) {
+        simulate(nullptr, &serialTicks);
+        simulate(&threads, &parallelTicks);
+    }
+
+    auto mean = [](const std::vector<double> &ms) {
+        return std::accumulate(ms.begin(), ms.end(), 0.0) / ms.size();
+    };
+    std::cerr << "mobs: " << mean(serialTicks) << " ms per tick for " << spawned << " mobs ("
+              << mean(parallelTicks) << " ms on " << threads.threadCount() << " threads)" << std::endl;
+
+    out << "    {\n"
+        << "      \"suite\": \"mobs\",\n"
+        << "      \"mobs\": " << spawned << ",\n"
+        << "      \"ticks\": " << m_options.ticks << ",\n"
+        << "      \"threads\": " << threads.threadCount() << ",\n"
+        << "      \"grounded_fraction\": " << static_cast<double>(grounded) / std::max(1, spawned) << ",\n"
+        << "      \"tick_ms\": {\"serial\": {\"mean\": " << mean(serialTicks)
+        << ", \"p95\": " << percentile(serialTicks, 0.95) << "}, \"parallel\": {\"mean\": "
+        << mean(parallelTicks) << ", \"p95\": " << percentile(parallelTicks, 0.95) << "}}\n"
+        << "    }";
+}
+
+void CoreBenchmark::runSpatial(std::ostream &out)
+{
+    out << "    {\n"
+        << "      \"suite\": \"spatial\",\n"
+        << "      \"queries\": " << m_options.queries << ",\n"
+        << "      \"populations\": [\n";
+    const int populations[] = {1000, 10000, 100000};
+    for (int i = 0; i < 3; ++i) {
+        runSpatial(out, populations[i]);
+        out << (i < 2 ? ",\n" : "\n");
+    }
+    out << "      ]\n"
+        << "    }";
+}
+
+void CoreBenchmark::runSpatial(std::ostream &out, int entityCount)
+{
+    // Mob-sized boxes at one per 16 square blocks, however many there are,
+    // so every population sees the same crowding around each query
+    std::mt19937 rng(m_options.seed);
+    float side = glm::sqrt(16.f * entityCount);
+    std::uniform_real_distribution<float> horizontal(0.f, side);
+    std::uniform_real_distribution<float> vertical(120.f, 136.f);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+    auto randomBox = [&](glm::vec3 position) {
+        glm::vec3 half(0.3f + 0.2f * unit(rng), 0.45f + 0.4f * unit(rng), 0.f);
+        half.z = half.x;
+        return AABB(position - glm::vec3(half.x, 0.f, half.z), position + glm::vec3(half.x, 2.f * half.y, half.z));
+    };
+    std::vector<AABB> boxes(entityCount);
+    for (AABB &b : boxes) {
+        b = randomBox(glm::vec3(horizontal(rng), vertical(rng), horizontal(rng)));
+    }
+    std::vector<glm::vec3> centers(m_options.queries), directions(m_options.queries);
+    for (int i = 0; i < m_options.queries; ++i) {
+        centers[i] = glm::vec3(horizontal(rng), vertical(rng), horizontal(rng));
+        directions[i] = glm::normalize(glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f) + 1e-3f);
+    }
+    const float radius = 4.f;
+
+    double buildMs = 0, radiusMs = 0, boxMs = 0, rayMs = 0, updateMs = 0, pairsMs = 0;
+    size_t found = 0, pairs = 0;
+    std::vector<int> ids;
+    std::vector<std::pair<int, int>> pairList;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        SpatialHash hash;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < entityCount; ++i) {
+            hash.insert(i, boxes[i]);
+        }
+        buildMs += msSince(start);
+
+        found = 0;
+        start = Clock::now();
+        for (glm::vec3 c : centers) {
+            ids.clear();
+            hash.queryRadius(c, radius, &ids);
+            found += ids.size();
+        }
+        radiusMs += msSince(start);
+
+        start = Clock::now();
+        for (glm::vec3 c : centers) {
+            ids.clear();
+            hash.queryAABB(AABB(c - radius, c + radius), &ids);
+        }
+        boxMs += msSince(start);
+
+        start = Clock::now();
+        for (int i = 0; i < m_options.queries; ++i) {
+            hash.raycast(centers[i], directions[i], 8.f);
+        }
+        rayMs += msSince(start);
+
+        // One tick of every entity walking a short step
+        start = Clock::now();
+        for (int i = 0; i < entityCount; ++i) {
+            glm::vec3 step(0.05f * (i % 7) - 0.15f, 0.f, 0.05f * (i % 5) - 0.1f);
+            hash.update(i, boxes[i].translated(step));
+        }
+        updateMs += msSince(start);
+
+        pairList.clear();
+        start = Clock::now();
+        hash.queryPairs(&pairList);
+        pairsMs += msSince(start);
+        pairs = pairList.size();
+    }
+
+    // The brute force scan, on fewer queries since each one visits every entity
+    int bruteQueries = std::max(1, std::min(m_options.queries, 10000000 / entityCount));
+    size_t bruteFound = 0;
+    Clock::time_point start = Clock::now();
+    for (int q = 0; q < bruteQueries; ++q) {
+        for (const AABB &b : boxes) {
+            glm::vec3 d = glm::clamp(centers[q], b.min, b.max) - centers[q];
+            bruteFound += glm::dot(d, d) <= radius * radius;
+        }
+    }
+    double bruteMs = msSince(start);
+
+    SpatialHash check;
+    for (int i = 0; i < entityCount; ++i) {
+        check.insert(i, boxes[i]);
+    }
+    size_t hashFound = 0;
+    for (int q = 0; q < bruteQueries; ++q) {
+        ids.clear();
+        check.queryRadius(centers[q], radius, &ids);
+        hashFound += ids.size();
+    }
+    if (hashFound != bruteFound) {
+        std::cerr << "SpatialHash and brute force disagree: " << hashFound << " vs " << bruteFound << " neighbors" << std::endl;
+    }
+
+    double queries = static_cast<double>(m_options.queries) * m_options.repeat;
+    auto perSecond = [](double count, double ms) {
+        return ms > 0 ? 1000.0 * count / ms : 0.0;
+    };
+    std::cerr << "spatial: " << entityCount << " entities, " << perSecond(queries, radiusMs) / 1e6
+              << " M radius queries/s (brute force " << perSecond(bruteQueries, bruteMs) / 1e6 << " M)" << std::endl;
+
+    out << "        {\"entities\": " << entityCount << ", \"mean_neighbors\": " << found / static_cast<double>(m_options.queries)
+        << ", \"overlapping_pairs\": " << pairs
+        << ",\n         \"queries_per_second\": {\"radius\": " << perSecond(queries, radiusMs)
+        << ", \"aabb\": " << perSecond(queries, boxMs) << ", \"ray\": " << perSecond(queries, rayMs)
+        << ", \"brute_force_radius\": " << perSecond(bruteQueries, bruteMs) << "}"
+        << ",\n         \"ms_mean\": {\"build\": " << buildMs / m_options.repeat
+        << ", \"update_all\": " << updateMs / m_options.repeat << ", \"pairs\": " << pairsMs / m_options.repeat << "}}";
+}
+
+void CoreBenchmark::runLighting(std::ostream &out)
+{
+    Terrain terrain;
+    generateWorld(&terrain);
+    std::vector<Chunk*> chunks = terrain.getChunksFrontToBack(worldMin(), worldMax(), worldMin(), worldMax(),
+                                                              glm::vec3(0.f));
+
+    // Every kind of edit is undone by the next one, so each
+    // repetition edits the same world in the same places
+    struct EditKind {
+        const char *name;
+        int dy;          // Height of the edited block above the surface block of its column
+        bool restore;    // Put back the block that was there before the previous edit
+        BlockType type;
+    };
+    const EditKind kinds[] = {
+        {"dig", 0, false, BlockType::EMPTY},        // Opens the block below to the sky
+        {"refill", 0, true, BlockType::EMPTY},
+        {"place", 1, false, BlockType::STONE},      // Casts a shadow down the column
+        {"unplace", 1, false, BlockType::EMPTY},
+        {"place_lava", 1, false, BlockType::LAVA},  // Lights up its surroundings
+        {"remove_lava", 1, false, BlockType::EMPTY},
+    };
+    const int kindCount = sizeof(kinds) / sizeof(kinds[0]);
+
+    std::mt19937 rng(m_options.seed);
+    std::uniform_int_distribution<int> horizontal(worldMin(), worldMax() - 1);
+    std::vector<glm::ivec3> surface(m_options.edits);
+    for (glm::ivec3 &p : surface) {
+        p = glm::ivec3(horizontal(rng), 0, horizontal(rng));
+        p.y = glm::max(terrain.surfaceHeight(p.x, p.z), 0);
+    }
+
+    // The sky and block light of every block an edit at pos can relight:
+    // its columns within light's reach, from bedrock to the sky
+    const int reach = 15;
+    auto lightAround = [&](glm::ivec3 pos, std::vector<uint8_t> *light) {
+        light->clear();
+        for (int x = pos.x - reach; x <= pos.x + reach; ++x) {
+            for (int z = pos.z - reach; z <= pos.z + reach; ++z) {
+                const Chunk *c = terrain.findChunkAt(x, z);
+                if (c == nullptr) {
+                    continue;
+                }
+                glm::ivec2 origin = c->getOrigin();
+                unsigned int lx = x - origin.x, lz = z - origin.y;
+                for (unsigned int y = 0; y < 256; ++y) {
+                    light->push_back(static_cast<uint8_t>(c->getSkyLightAt(lx, y, lz) << 4 | c->getBlockLightAt(lx, y, lz)));
+                }
+            }
+        }
+    };
+
+    std::vector<std::vector<double>> us(kindCount);
+    std::vector<double> chunksChanged(kindCount, 0.0);
+    std::vector<int> drifted(kindCount, 0);
+    std::vector<uint64_t> revisions(chunks.size());
+    std::vector<uint8_t> lightBefore, lightAfter;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        for (const glm::ivec3 &p : surface) {
+            BlockType previous;
+            for (int k = 0; k < kindCount; ++k) {
+                glm::ivec3 pos = p + glm::ivec3(0, kinds[k].dy, 0);
+                // Each repetition makes the same edits to the same world,
+                // so checking the first is enough
+                bool check = r == 0;
+                if (check && k % 2 == 0) {
+                    lightAround(pos, &lightBefore);
+                }
+                BlockType type = kinds[k].restore ? previous : kinds[k].type;
+                terrain.tryGetBlockAt(pos.x, pos.y, pos.z, &previous);
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    revisions[i] = chunks[i]->getRevision();
+                }
+
+                Clock::time_point start = Clock::now();
+                terrain.editBlockAt(pos.x, pos.y, pos.z, type);
+                us[k].push_back(1000.0 * msSince(start));
+
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    chunksChanged[k] += chunks[i]->getRevision() != revisions[i];
+                }
+
+                // Every edit is undone by the next, and relighting
+                // incrementally has to put the light back exactly
+                if (check && k % 2 == 1) {
+                    lightAround(pos, &lightAfter);
+                    drifted[k] += lightAfter != lightBefore;
+                }
+            }
+        }
+    }
+    int driftedTotal = std::accumulate(drifted.begin(), drifted.end(), 0);
+    if (driftedTotal > 0) {
+        std::cerr << "Light differs after undoing " << driftedTotal << " edits" << std::endl;
+        m_failed = true;
+    }
+
+    out << "    {\n"
+        << "      \"suite\": \"lighting\",\n"
+        << "      \"edits\": " << m_options.edits << ",\n"
+        << "      \"kinds\": [\n";
+    for (int k = 0; k < kindCount; ++k) {
+        double mean = std::accumulate(us[k].begin(), us[k].end(), 0.0) / us[k].size();
+        std::cerr << "lighting: " << kinds[k].name << " " << mean << " us per edit" << std::endl;
+        out << "        {\"name\": \"" << kinds[k].name << "\", \"us_mean\": " << mean
+            << ", \"us_p95\": " << percentile(us[k], 0.95)
+            << ", \"us_max\": " << *std::max_element(us[k].begin(), us[k].end())
+            << ", \"chunks_to_remesh_mean\": " << chunksChanged[k] / us[k].size()
+            << (k % 2 == 1 ? ", \"light_drifted\": " + std::to_string(drifted[k]) : std::string()) << "}"
+            << (k + 1 < kindCount ? ",\n" : "\n");
+    }
+    out << "      ]\n"
+        << "    }";
+}
+
+// Hashes of the 2 x 2 terrain zones around the origin, generated with
+// Terrain's default biome sampling, for a few fixed seeds. A change that
+// is meant to alter the generated world has to update these; any other
+// mismatch means an optimization changed what gets generated.
+static const struct {
+    int seed;
+    uint64_t hash;
+} GOLDEN_WORLDS[] = {
+    {1337, 0x3bb55feb5cfef8a8ull},
+    {0, 0xa307be9bcbaadfc0ull},
+    {-20211, 0xa95ea8bebfb5c9c1ull},
+    {987654, 0x39db13bf60b4df57ull},
+};
+
+// Combines the content hashes of every Chunk in [min, max) on x and z
+static uint64_t worldHash(const Terrain &terrain, int min, int max)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int x = min; x < max; x += 16) {
+        for (int z = min; z < max; z += 16) {
+            const Chunk *c = terrain.findChunkAt(x, z);
+            hash = (hash ^ (c != nullptr ? c->contentHash() : 0)) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// Seeds far from the origin used to push the noise out to where a float
+// can no longer tell neighbouring samples apart, which flattened the world
+static const int LARGE_SEEDS[] = {50000000, INT_MAX, INT_MIN};
+
+// Fewer distinct grassland heights than this over the sampled square means
+// the seed has collapsed the terrain; working seeds give more than 30
+static const int MIN_DISTINCT_HEIGHTS = 16;
+
+// Counts the distinct grassland heights on a 16 x 16 grid of columns spread
+// over a 256 x 256 square around the origin
+static int distinctHeights(Terrain &terrain)
+{
+    std::set<int> heights;
+    for (int x = -128; x < 128; x += 16) {
+        for (int z = -128; z < 128; z += 16) {
+            heights.insert(terrain.heightMapGrassland(x, z));
+        }
+    }
+    return static_cast<int>(heights.size());
+}
+
+static std::string toHex(uint64_t value)
+{
+    char text[19];
+    snprintf(text, sizeof(text), "0x%016llx", static_cast<unsigned long long>(value));
+    return text;
+}
+
+void CoreBenchmark::runDeterminism(std::ostream &out)
+{
+    // The zones are generated in several orders, on several threads, one
+    // Chunk at a time from a corner, and again after being unloaded, each
+    // of which has to produce the same world, since light and features
+    // spread between zones
+    std::vector<glm::ivec2> zones;
+    for (int x = -64; x < 64; x += 64) {
+        for (int z = -64; z < 64; z += 64) {
+            zones.push_back(glm::ivec2(x, z));
+        }
+    }
+    const char *orders[] = {"forward", "reverse", "shuffled", "threaded", "chunk_by_chunk", "reloaded"};
+    const int orderCount = sizeof(orders) / sizeof(orders[0]);
+    ThreadPool threads(3);
+
+    out << "    {\n"
+        << "      \"suite\": \"determinism\",\n"
+        << "      \"worlds\": [\n";
+    const int worldCount = sizeof(GOLDEN_WORLDS) / sizeof(GOLDEN_WORLDS[0]);
+    for (int w = 0; w < worldCount; ++w) {
+        int seed = GOLDEN_WORLDS[w].seed;
+        std::vector<uint64_t> hashes;
+        bool bounded = true;
+        for (int o = 0; o < orderCount; ++o) {
+            std::vector<glm::ivec2> order = zones;
+            if (o == 1) {
+                std::reverse(order.begin(), order.end());
+            } else if (o == 2) {
+                std::shuffle(order.begin(), order.end(), std::mt19937(seed));
+            }
+            Terrain terrain(seed);
+            if (o == 3) {
+                terrain.setThreadPool(&threads);
+            }
+            if (o == 4) {
+                terrain.requestChunks(-64, 64, -64, 64);
+                while (terrain.generateRequested(1, glm::vec3(-64.f, 0.f, -64.f)) > 0) {}
+            } else if (o == 5) {
+                // Every zone but one goes back to the pool, and the
+                // recycled Chunks are generated anew around it
+                for (const glm::ivec2 &zone : order) {
+                    terrain.generateTerrain(zone.x, zone.y);
+                }
+                terrain.unloadChunksOutside(0, 64, 0, 64);
+                for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                    terrain.generateTerrain(it->x, it->y);
+                }
+            } else {
+                for (const glm::ivec2 &zone : order) {
+                    terrain.generateTerrain(zone.x, zone.y);
+                }
+            }
+            hashes.push_back(worldHash(terrain, -64, 64));
+
+            // Features reaching past the edge must not have created any Chunks there
+            for (int along = -80; along < 80; along += 16) {
+                if (terrain.findChunkAt(along, -80) || terrain.findChunkAt(along, 64) ||
+                    terrain.findChunkAt(-80, along) || terrain.findChunkAt(64, along)) {
+                    bounded = false;
+                }
+            }
+        }
+
+        bool consistent = true;
+        for (int o = 1; o < orderCount; ++o) {
+            if (hashes[o] != hashes[0]) {
+                consistent = false;
+                std::cerr << "Seed " << seed << " generated " << orders[o] << " gives " << toHex(hashes[o])
+                          << " but " << orders[0] << " gives " << toHex(hashes[0]) << std::endl;
+            }
+        }
+        bool matches = hashes[0] == GOLDEN_WORLDS[w].hash;
+        if (!matches) {
+            std::cerr << "Seed " << seed << " generates " << toHex(hashes[0]) << ", expected "
+                      << toHex(GOLDEN_WORLDS[w].hash) << std::endl;
+        }
+        if (!bounded) {
+            std::cerr << "Seed " << seed << " generated Chunks outside the requested area" << std::endl;
+        }
+        m_failed = m_failed || !consistent || !matches || !bounded;
+        std::cerr << "determinism: seed " << seed << (consistent && matches && bounded ? " ok" : " FAILED") << std::endl;
+
+        out << "        {\"seed\": " << seed << ", \"hash\": \"" << toHex(hashes[0])
+            << "\", \"golden\": \"" << toHex(GOLDEN_WORLDS[w].hash)
+            << "\", \"order_independent\": " << (consistent ? "true" : "false")
+            << ", \"matches_golden\": " << (matches ? "true" : "false")
+            << ", \"bounded\": " << (bounded ? "true" : "false") << "}"
+            << (w + 1 < worldCount ? ",\n" : "\n");
+    }
+    out << "      ],\n"
+        << "      \"height_variety\": [\n";
+
+    std::vector<int> varietySeeds;
+    for (int w = 0; w < worldCount; ++w) {
+        varietySeeds.push_back(GOLDEN_WORLDS[w].seed);
+    }
+    varietySeeds.insert(varietySeeds.end(), std::begin(LARGE_SEEDS), std::end(LARGE_SEEDS));
+    for (size_t i = 0; i < varietySeeds.size(); ++i) {
+        int seed = varietySeeds[i];
+        Terrain terrain(seed);
+        int distinct = distinctHeights(terrain);
+        bool varied = distinct >= MIN_DISTINCT_HEIGHTS;
+        m_failed = m_failed || !varied;
+        std::cerr << "determinism: seed " << seed << " has " << distinct << " distinct heights"
+                  << (varied ? "" : " FAILED") << std::endl;
+
+        out << "        {\"seed\": " << seed << ", \"distinct_heights\": " << distinct
+            << ", \"varied\": " << (varied ? "true" : "false") << "}"
+            << (i + 1 < varietySeeds.size() ? ",\n" : "\n");
+    }
+    out << "      ]\n"
+        << "    }";
+}
+
+bool CoreBenchmark::run(std::ostream &out)
+{
+    out << "{\n"
+        << "  \"benchmark\": \"core\",\n"
+        << "  \"seed\": " << m_options.seed << ",\n"
+        << "  \"zones\": " << m_options.zones << ",\n"
+        << "  \"repeat\": " << m_options.repeat << ",\n"
+        << "  \"suites\": [";
+
+    bool first = true;
+    if (m_options.generation) {
+        out << (first ? "\n" : ",\n");
+        runGeneration(out);
+        first = false;
+    }
+    if (m_options.meshing) {
+        out << (first ? "\n" : ",\n");
+        runMeshing(out);
+        first = false;
+    }
+    if (m_options.raycast) {
+        out << (first ? "\n" : ",\n");
+        runRaycast(out);
+        first = false;
+    }
+    if (m_options.collision) {
+        out << (first ? "\n" : ",\n");
+        runCollision(out);
+        first = false;
+    }
+    if (m_options.mobs) {
+        out << (first ? "\n" : ",\n");
+        runMobs(out);
+        first = false;
+    }
+    if (m_options.spatial) {
+        out << (first ? "\n" : ",\n");
+        runSpatial(out);
+        first = false;
+    }
+    if (m_options.lighting) {
+        out << (first ? "\n" : ",\n");
+        runLighting(out);
+        first = false;
+    }
+    if (m_options.determinism) {
+        out << (first ? "\n" : ",\n");
+        runDeterminism(out);
+        first = false;
+    }
+    if (m_options.noise) {
+        out << (first ? "\n" : ",\n");
+        runNoise(out);
+        first = false;
+    }
+    if (m_options.lookup) {
+        out << (first ? "\n" : ",\n");
+        runLookup(out);
+        first = false;
+    }
+    if (m_options.streaming) {
+        out << (first ? "\n" : ",\n");
+        runStreaming(out);
+        first = false;
+    }
+    if (m_options.snapshot) {
+        out << (first ? "\n" : ",\n");
+        runSnapshot(out);
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+    return !m_failed;
+}
+
+// The FBM every height map used before FBMParameters: the octave
+// weights went through pow into a fresh std::vector on every sample.
+// Kept here only to compare costs and results against; it samples the
+// same points as Noise, with the seed only picking the gradients.
+static float legacyHybridMultiFractal(float x, float z, int seed, float H, float scale)
+{
+    float lacunarity = 10;
+    float octaves = 8;
+    float offset = .7;
+    float frequency, result, signal, weight, pX, pZ;
+    std::vector<float> exp = std::vector<float>();
+    frequency = 1;
+    for (int i = 0; i < octaves; i++)
+    {
+        exp.push_back(pow(frequency, -H));
+        frequency *= lacunarity;
+    }
+    pX = x / scale * exp.at(0);
+    pZ = z / scale * exp.at(0);
+    result = (1 - glm::abs(Noise::perlin(pX, pZ, seed)) + offset) * exp.at(0);
+    weight = result;
+    x *= lacunarity;
+    z *= lacunarity;
+    for (int i = 1; i < octaves; i++)
+    {
+        if (weight > 1) { weight = 1; }
+        pX = x / scale * exp.at(i);
+        pZ = z / scale * exp.at(i);
+        signal = (1 - glm::abs(Noise::perlin(pX, pZ, seed)) + offset) * exp.at(i);
+        result += weight * signal;
+        weight *= signal;
+        x *= lacunarity;
+        z *= lacunarity;
+    }
+    return result;
+}
+
+void CoreBenchmark::runNoise(std::ostream &out)
+{
+    // The three height maps of Terrain, which should all agree exactly
+    // with the legacy FBM
+    struct Map {
+        const char *name;
+        float H, scale;
+    } maps[] = {{"grassland", .6f, 333.f}, {"mountains", .5f, 200.f}, {"biome", .9f, 2345.f}};
+    const int mapCount = sizeof(maps) / sizeof(maps[0]);
+
+    std::mt19937 rng(m_options.seed);
+    std::uniform_int_distribution<int> coord(-100000, 100000);
+    std::vector<glm::ivec2> points(m_options.samples);
+    for (glm::ivec2 &p : points) {
+        p = glm::ivec2(coord(rng), coord(rng));
+    }
+
+    out << "    {\n"
+        << "      \"suite\": \"noise\",\n"
+        << "      \"samples\": " << m_options.samples << ",\n"
+        << "      \"maps\": [\n";
+    for (int m = 0; m < mapCount; ++m) {
+        FBMParameters<> params(maps[m].H, maps[m].scale);
+        std::vector<double> ms, legacyMs;
+        double maxDiff = 0.0;
+        volatile float sink = 0.f;
+        for (int r = 0; r < m_options.repeat; ++r) {
+            Clock::time_point start = Clock::now();
+            float sum = 0.f;
+            for (const glm::ivec2 &p : points) {
+                sum += Noise::hybridMultiFractal<RidgedPerlin>(params, p.x, p.y, m_options.seed);
+            }
+            ms.push_back(msSince(start));
+            sink = sum;
+
+            start = Clock::now();
+            sum = 0.f;
+            for (const glm::ivec2 &p : points) {
+                sum += legacyHybridMultiFractal(p.x, p.y, m_options.seed, maps[m].H, maps[m].scale);
+            }
+            legacyMs.push_back(msSince(start));
+            sink = sum;
+        }
+        (void) sink;
+        for (const glm::ivec2 &p : points) {
+            float a = Noise::hybridMultiFractal<RidgedPerlin>(params, p.x, p.y, m_options.seed);
+            float b = legacyHybridMultiFractal(p.x, p.y, m_options.seed, maps[m].H, maps[m].scale);
+            maxDiff = std::max(maxDiff, static_cast<double>(std::abs(a - b)));
+        }
+
+        double ns = 1e6 * *std::min_element(ms.begin(), ms.end()) / m_options.samples;
+        double legacyNs = 1e6 * *std::min_element(legacyMs.begin(), legacyMs.end()) / m_options.samples;
+        std::cerr << "noise: " << maps[m].name << " " << ns << " ns per sample (" << legacyNs
+                  << " ns with per-call weights)" << std::endl;
+        if (maxDiff != 0.0) {
+            std::cerr << "The " << maps[m].name << " FBM differs from the legacy one by up to " << maxDiff << std::endl;
+            m_failed = true;
+        }
+        out << "        {\"name\": \"" << maps[m].name << "\", \"ns_per_sample_min\": " << ns
+            << ", \"legacy_ns_per_sample_min\": " << legacyNs
+            << ", \"max_abs_diff\": " << maxDiff << "}"
+            << (m + 1 < mapCount ? ",\n" : "\n");
+    }
+    out << "      ]\n"
+        << "    }";
+}
+
+// How Terrain found the Chunk holding a block before ChunkMap: a float
+// floor to the Chunk corner and a std::unordered_map lookup. Kept here
+// only to compare costs against.
+static Chunk* legacyFindChunkAt(const std::unordered_map<int64_t, Chunk*> &chunks, int x, int z)
+{
+    int xFloor = static_cast<int>(glm::floor(x / 16.f));
+    int zFloor = static_cast<int>(glm::floor(z / 16.f));
+    auto it = chunks.find(toKey(16 * xFloor, 16 * zFloor));
+    return it == chunks.end() ? nullptr : it->second;
+}
+
+void CoreBenchmark::runLookup(std::ostream &out)
+{
+    Terrain terrain;
+    generateWorld(&terrain);
+    std::unordered_map<int64_t, Chunk*> legacy;
+    for (int x = worldMin(); x < worldMax(); x += 16) {
+        for (int z = worldMin(); z < worldMax(); z += 16) {
+            legacy[toKey(x, z)] = terrain.findChunkAt(x, z);
+        }
+    }
+
+    // Block coordinates in and a little around the world, so some miss
+    std::mt19937 rng(m_options.seed);
+    std::uniform_int_distribution<int> coord(worldMin() - 32, worldMax() + 31);
+    std::vector<glm::ivec2> points(m_options.queries);
+    for (glm::ivec2 &p : points) {
+        p = glm::ivec2(coord(rng), coord(rng));
+    }
+
+    std::vector<double> ms, legacyMs;
+    int mismatches = 0;
+    for (int r = 0; r < m_options.repeat; ++r) {
+        // Sum the pointers so the lookups can't be optimized away
+        uintptr_t sum = 0, legacySum = 0;
+        Clock::time_point start = Clock::now();
+        for (const glm::ivec2 &p : points) {
+            sum += reinterpret_cast<uintptr_t>(terrain.findChunkAt(p.x, p.y));
+        }
+        ms.push_back(msSince(start));
+
+        start = Clock::now();
+        for (const glm::ivec2 &p : points) {
+            legacySum += reinterpret_cast<uintptr_t>(legacyFindChunkAt(legacy, p.x, p.y));
+        }
+        legacyMs.push_back(msSince(start));
+        mismatches += sum != legacySum;
+    }
+    for (const glm::ivec2 &p : points) {
+        mismatches += terrain.findChunkAt(p.x, p.y) != legacyFindChunkAt(legacy, p.x, p.y);
+    }
+
+    double ns = 1e6 * *std::min_element(ms.begin(), ms.end()) / m_options.queries;
+    double legacyNs = 1e6 * *std::min_element(legacyMs.begin(), legacyMs.end()) / m_options.queries;
+    std::cerr << "lookup: " << ns << " ns per Chunk lookup (" << legacyNs << " ns with std::unordered_map)" << std::endl;
+    if (mismatches > 0) {
+        std::cerr << "ChunkMap found a different Chunk than std::unordered_map " << mismatches << " times" << std::endl;
+        m_failed = true;
+    }
+
+    out << "    {\n"
+        << "      \"suite\": \"lookup\",\n"
+        << "      \"chunks\": " << legacy.size() << ",\n"
+        << "      \"queries\": " << m_options.queries << ",\n"
+        << "      \"ns_per_lookup_min\": " << ns << ",\n"
+        << "      \"unordered_map_ns_per_lookup_min\": " << legacyNs << ",\n"
+        << "      \"mismatches\": " << mismatches << "\n"
+        << "    }";
+}
+
+void CoreBenchmark::runStreaming(std::ostream &out)
+{
+    // A player walking along x one Chunk per step, with the loaded area
+    // kept the way MyGL keeps it: Chunks are requested a zone either side
+    // of the player and unloaded half a zone beyond that. The first steps
+    // fill the pool; after them every Chunk should come out of it.
+    const int warmupSteps = 8, steps = 8 + 8 * m_options.repeat;
+    Terrain terrain(m_options.seed);
+    std::vector<double> ms;
+    int warmupAllocated = 0, unloaded = 0;
+    // The filed features must stay bounded by the loaded area too: only
+    // Chunks in or next to the 12 x 12 kept loaded may have their features
+    // filed, and the filed blocks must not keep growing with the distance
+    // walked
+    const int maxFeatureSources = 14 * 14;
+    int warmupPending = 0, maxPending = 0, maxSources = 0;
+    for (int step = 0; step < steps; ++step) {
+        int x = 16 * step;
+        Clock::time_point start = Clock::now();
+        terrain.requestChunks(x - 64, x + 64, -64, 64);
+        while (terrain.generateRequested(16, glm::vec3(x, 0.f, 0.f)) > 0) {}
+        unloaded += terrain.unloadChunksOutside(x - 96, x + 96, -96, 96);
+        if (step < warmupSteps) {
+            warmupAllocated = terrain.getChunkPool().getStats().allocated;
+            warmupPending = std::max(warmupPending, terrain.pendingBlockCount());
+        } else {
+            ms.push_back(msSince(start));
+            maxPending = std::max(maxPending, terrain.pendingBlockCount());
+        }
+        maxSources = std::max(maxSources, terrain.featureSourceCount());
+    }
+    const ChunkPoolStats &stats = terrain.getChunkPool().getStats();
+    int steadyAllocated = stats.allocated - warmupAllocated;
+    if (steadyAllocated > 0) {
+        std::cerr << "Roaming allocated " << steadyAllocated << " Chunks after the pool had filled" << std::endl;
+        m_failed = true;
+    }
+    if (maxSources > maxFeatureSources) {
+        std::cerr << "Roaming kept the features of " << maxSources << " Chunks filed, more than the "
+                  << maxFeatureSources << " in or next to the loaded area" << std::endl;
+        m_failed = true;
+    }
+    // How many blocks get filed varies with the trees in view, but not by
+    // half again as much as over the warmup
+    if (2 * maxPending > 3 * warmupPending) {
+        std::cerr << "Roaming grew the filed feature blocks from " << warmupPending << " to " << maxPending << std::endl;
+        m_failed = true;
+    }
+
+    // What recycling saves over allocating: a fresh Chunk fills every
+    // block, a recycled one only the sections that held terrain
+    const int chunkCount = 16;
+    ChunkPool pool;
+    std::vector<uPtr<Chunk>> chunks;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < chunkCount; ++i) {
+        chunks.push_back(pool.acquire(16 * i, 0));
+    }
+    double freshMs = msSince(start) / chunkCount;
+    for (uPtr<Chunk> &c : chunks) {
+        // Terrain up to about sea level, as most generated Chunks have
+        for (int y = 0; y < 140; ++y) {
+            for (int z = 0; z < 16; ++z) {
+                for (int x = 0; x < 16; ++x) {
+                    c->setBlockAt(x, y, z, BlockType::STONE);
+                }
+            }
+        }
+        pool.release(std::move(c));
+    }
+    chunks.clear();
+    start = Clock::now();
+    for (int i = 0; i < chunkCount; ++i) {
+        chunks.push_back(pool.acquire(16 * i, 16));
+    }
+    double recycledMs = msSince(start) / chunkCount;
+
+    std::cerr << "streaming: " << percentile(ms, 0.5) << " ms per step, " << steadyAllocated
+              << " Chunks allocated after warmup (" << warmupAllocated << " during), " << stats.reused
+              << " reused; " << freshMs << " ms per fresh Chunk, " << recycledMs << " ms per recycled" << std::endl;
+    std::cerr << "streaming: at most " << maxSources << " Chunks with filed features, " << maxPending
+              << " filed blocks (" << warmupPending << " during warmup, "
+              << maxPending * sizeof(PendingBlock) << " bytes)" << std::endl;
+
+    out << "    {\n"
+        << "      \"suite\": \"streaming\",\n"
+        << "      \"steps\": " << steps << ",\n"
+        << "      \"warmup_steps\": " << warmupSteps << ",\n"
+        << "      \"loaded_chunks\": " << terrain.chunkCount() << ",\n"
+        << "      \"unloaded_chunks\": " << unloaded << ",\n"
+        << "      \"warmup_allocated\": " << warmupAllocated << ",\n"
+        << "      \"steady_allocated\": " << steadyAllocated << ",\n"
+        << "      \"reused\": " << stats.reused << ",\n"
+        << "      \"feature_sources_max\": " << maxSources << ",\n"
+        << "      \"pending_blocks_warmup_max\": " << warmupPending << ",\n"
+        << "      \"pending_blocks_max\": " << maxPending << ",\n"
+        << "      \"pending_block_bytes_max\": " << maxPending * sizeof(PendingBlock) << ",\n"
+        << "      \"ms_per_step_median\": " << percentile(ms, 0.5) << ",\n"
+        << "      \"fresh_chunk_ms\": " << freshMs << ",\n"
+        << "      \"recycled_chunk_ms\": " << recycledMs << "\n"
+        << "    }";
+}
+
+// A 64-bit FNV-1a hash of a mesh's vertices
+static uint64_t meshHash(const ChunkMesh &mesh)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const MeshBuffer<float> *buffer : {&mesh.vertices, &mesh.verticesTransparent}) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(buffer->data());
+        for (size_t i = 0; i < buffer->size() * sizeof(float); ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+void CoreBenchmark::runSnapshot(std::ostream &out)
+{
+    Terrain terrain(m_options.seed);
+    generateWorld(&terrain);
+    std::vector<Chunk*> chunks;
+    for (Chunk *c : terrain.getChunksFrontToBack(worldMin(), worldMax(), worldMin(), worldMax(), glm::vec3(0.f))) {
+        if (c->isReadyToMesh()) {
+            chunks.push_back(c);
+        }
+    }
+
+    // Worker threads mesh snapshots while this thread keeps editing the
+    // Chunks they were taken from, as a renderer meshing off the main
+    // thread would. Every mesh must match the Chunk as it was when its
+    // snapshot was taken, and those whose Chunk has changed since must be
+    // recognized as stale. Run under ThreadSanitizer, this also checks
+    // that edits never write to blocks a worker is reading.
+    struct Job {
+        uPtr<ChunkSnapshot> snapshot;
+        uint64_t expected; // Hash of the Chunk's mesh when the snapshot was taken
+        uint64_t hash;     // Hash of the mesh the worker built
+    };
+    const int workerCount = 2, jobCount = 16 * m_options.repeat;
+    std::mutex mutex;
+    std::condition_variable jobReady, jobDone;
+    std::deque<Job> pending, done;
+    bool stopping = false;
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&]() {
+            ChunkMesh mesh;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                jobReady.wait(lock, [&]() { return stopping || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                Job job = std::move(pending.front());
+                pending.pop_front();
+                lock.unlock();
+                job.snapshot->getChunk().createMeshData(&mesh);
+                job.hash = meshHash(mesh);
+                lock.lock();
+                done.push_back(std::move(job));
+                jobDone.notify_one();
+            }
+        });
+    }
+
+    std::mt19937 rng(m_options.seed);
+    std::uniform_int_distribution<int> pick(0, static_cast<int>(chunks.size()) - 1), local(0, 15);
+    ChunkMesh mesh;
+    std::vector<double> snapshotUs;
+    int inFlight = 0, finished = 0, stale = 0, mismatches = 0, edits = 0;
+    auto finish = [&](Job &job) {
+        mismatches += job.hash != job.expected;
+        stale += !job.snapshot->isCurrent();
+        finished++;
+        inFlight--;
+        // Snapshots are destroyed on the editing thread (see ChunkSnapshot)
+        job.snapshot = nullptr;
+    };
+    for (int j = 0; j < jobCount; ++j) {
+        Chunk *c = chunks[pick(rng)];
+        c->createMeshData(&mesh);
+        Job job{nullptr, meshHash(mesh), 0};
+        Clock::time_point start = Clock::now();
+        job.snapshot = mkU<ChunkSnapshot>(*c);
+        snapshotUs.push_back(1000.0 * msSince(start));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(job));
+            inFlight++;
+        }
+        jobReady.notify_one();
+
+        // Half of the Chunks are edited while they are being meshed: blocks
+        // near the surface are dug out or filled in, relighting around them
+        if (rng() % 2 == 0) {
+            glm::ivec2 origin = c->getOrigin();
+            for (int e = 0; e < 4; ++e) {
+                int x = origin.x + local(rng), z = origin.y + local(rng);
+                int y = glm::clamp(terrain.surfaceHeight(x, z) + local(rng) % 3 - 1, 0, 255);
+                BlockType old;
+                terrain.tryGetBlockAt(x, y, z, &old);
+                terrain.editBlockAt(x, y, z, old == BlockType::EMPTY ? BlockType::STONE : BlockType::EMPTY);
+                edits++;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [&]() { return !done.empty() || inFlight < workerCount; });
+        while (!done.empty()) {
+            Job finishedJob = std::move(done.front());
+            done.pop_front();
+            finish(finishedJob);
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (inFlight > 0) {
+            jobDone.wait(lock, [&]() { return !done.empty(); });
+            Job finishedJob = std::move(done.front());
+            done.pop_front();
+            finish(finishedJob);
+        }
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    // What a snapshot saves over copying the blocks of the nine Chunks outright
+    std::vector<BlockType> blocks(9 * 65536), copy;
+    Clock::time_point start = Clock::now();
+    copy = blocks;
+    double deepCopyUs = 1000.0 * msSince(start);
+
+    double us = percentile(snapshotUs, 0.5);
+    std::cerr << "snapshot: " << us << " us per snapshot (" << deepCopyUs << " us to copy the blocks), "
+              << finished << " meshed during " << edits << " edits, " << stale << " stale, "
+              << mismatches << " mismatches" << std::endl;
+    if (mismatches > 0) {
+        std::cerr << "Meshes built from snapshots didn't match their Chunks " << mismatches << " times" << std::endl;
+        m_failed = true;
+    }
+
+    out << "    {\n"
+        << "      \"suite\": \"snapshot\",\n"
+        << "      \"jobs\": " << finished << ",\n"
+        << "      \"workers\": " << workerCount << ",\n"
+        << "      \"edits\": " << edits << ",\n"
+        << "      \"stale\": " << stale << ",\n"
+        << "      \"us_per_snapshot_median\": " << us << ",\n"
+        << "      \"deep_copy_us\": " << deepCopyUs << ",\n"
+        << "      \"mismatches\": " << mismatches << "\n"
+        << "    }";
+}
+
+static void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "Times terrain generation, meshing, raycasts, collisions, mobs, entity queries,\n"
+              << "relighting, FBM noise, Chunk lookups, Chunk streaming and meshing during edits on a\n"
+              << "fixed-seed world, and checks that generation still reproduces its golden worlds.\n"
+              << "Exits with 2 if a check fails.\n\n"
+              << "  --suite <name>    generation, meshing, raycast, collision, mobs,\n"
+              << "                    spatial, lighting, determinism, noise, lookup,\n"
+              << "                    streaming, snapshot or all\n"
+              << "                    (default all)\n"
+              << "  --seed <seed>     World seed (default 1337)\n"
+              << "  --zones <n>       World size in 64 x 64 terrain zones per side (default 3)\n"
+              << "  --repeat <n>      Measured repetitions of each suite (default 5)\n"
+              << "  --rays <n>        Rays cast per raycast repetition (default 100000)\n"
+              << "  --short-ray <l>   Length of the short rays in blocks (default 4)\n"
+              << "  --long-ray <l>    Length of the long rays in blocks (default 64)\n"
+              << "  --entities <n>    Entities simulated by the collision suite (default 1000)\n"
+              << "  --ticks <n>       Ticks simulated per collision and mob repetition (default 60)\n"
+              << "  --mobs <n>        Wandering mobs spawned by the mob suite (default 10000)\n"
+              << "  --queries <n>     Queries of each kind per spatial or lookup repetition\n"
+              << "                    (default 100000)\n"
+              << "  --edits <n>       Places edited per lighting repetition (default 200)\n"
+              << "  --samples <n>     FBM samples per noise repetition (default 200000)\n"
+              << "  --biome-step <n>  Blocks between biome noise samples, 1 for exact (default 8)\n"
+              << "  --biome-error <e> Largest biome weight interpolation error (default 0.01)\n"
+              << "  --output <file>   Write the JSON report to this file instead of stdout\n";
+}
+
+int runCoreBenchmark(int argc, char *argv[])
+{
+    CoreBenchmarkOptions options;
+    std::string output;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--suite") == 0) {
+            std::string suite = value;
+            options.generation = suite == "all" || suite == "generation";
+            options.meshing = suite == "all" || suite == "meshing";
+            options.raycast = suite == "all" || suite == "raycast";
+            options.collision = suite == "all" || suite == "collision";
+            options.mobs = suite == "all" || suite == "mobs";
+            options.spatial = suite == "all" || suite == "spatial";
+            options.lighting = suite == "all" || suite == "lighting";
+            options.determinism = suite == "all" || suite == "determinism";
+            options.noise = suite == "all" || suite == "noise";
+            options.lookup = suite == "all" || suite == "lookup";
+            options.streaming = suite == "all" || suite == "streaming";
+            options.snapshot = suite == "all" || suite == "snapshot";
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = atoi(value);
+        } else if (strcmp(arg, "--zones") == 0) {
+            options.zones = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--repeat") == 0) {
+            options.repeat = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--rays") == 0) {
+            options.rays = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--short-ray") == 0) {
+            options.shortRay = std::max(0.01f, static_cast<float>(atof(value)));
+        } else if (strcmp(arg, "--long-ray") == 0) {
+            options.longRay = std::max(0.01f, static_cast<float>(atof(value)));
+        } else if (strcmp(arg, "--entities") == 0) {
+            options.entities = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--ticks") == 0) {
+            options.ticks = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--mobs") == 0) {
+            options.mobCount = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--queries") == 0) {
+            options.queries = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--biome-step") == 0) {
+            options.biomeStep = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--biome-error") == 0) {
+            options.biomeError = static_cast<float>(std::max(0.0, atof(value)));
+        } else if (strcmp(arg, "--edits") == 0) {
+            options.edits = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--samples") == 0) {
+            options.samples = std::max(1, atoi(value));
+        } else if (strcmp(arg, "--output") == 0) {
+            output = value;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    CoreBenchmark benchmark(options);
+    if (!output.empty()) {
+        std::ofstream file(output);
+        if (!file) {
+            std::cerr << "Could not open " << output << std::endl;
+            return 1;
+        }
+        return benchmark.run(file) ? 0 : 2;
+    }
+    return benchmark.run(std::cout) ? 0 : 2;
+}
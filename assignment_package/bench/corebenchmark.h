@@ -0,0 +1,89 @@
+#pragma once
+
+#include "scene/terrain.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Settings for a CoreBenchmark run, parsed from the command line
+struct CoreBenchmarkOptions {
+    bool generation;   // Run the terrain generation suite
+    bool meshing;      // Run the Chunk meshing suite
+    bool raycast;      // Run the grid march suite
+    bool collision;    // Run the entity collision suite
+    bool mobs;         // Run the MobSystem stress suite
+    bool spatial;      // Run the SpatialHash query suite
+    bool lighting;     // Run the relighting suite
+    bool determinism;  // Check generated worlds against their golden hashes
+    bool noise;        // Run the FBM sampling suite
+    bool lookup;       // Run the Chunk lookup suite
+    bool streaming;    // Run the roaming load and unload suite
+    bool snapshot;     // Run the concurrent snapshot meshing suite
+    int seed;          // World seed, so every run builds the same terrain
+    int zones;         // The world is zones x zones terrain generation zones
+    int repeat;        // Measured repetitions of each suite
+    int rays;          // Rays cast per raycast repetition
+    float shortRay;    // Length of the short rays (picking, collision probes), in blocks
+    float longRay;     // Length of the long rays (line of sight, light probes), in blocks
+    int entities;      // Entities simulated by the collision suite
+    int ticks;         // Ticks simulated per collision and mob repetition
+    int mobCount;      // Wandering mobs spawned by the mob suite
+    int queries;       // Queries of each kind per spatial repetition
+    int edits;         // Places in the world edited per lighting repetition
+    int samples;       // FBM samples per noise repetition
+    int biomeStep;     // Spacing of the biome noise lattice (see Terrain::setBiomeSampling)
+    float biomeError;  // Largest interpolation error accepted in a biome weight
+
+    CoreBenchmarkOptions()
+        : generation(true), meshing(true), raycast(true), collision(true), mobs(true), spatial(true), lighting(true), determinism(true), noise(true), lookup(true), streaming(true), snapshot(true), seed(1337),
+          zones(3), repeat(5), rays(100000), shortRay(4.f), longRay(64.f), entities(1000), ticks(60),
+          mobCount(10000), queries(100000), edits(200), samples(200000), biomeStep(8), biomeError(0.01f)
+    {}
+};
+
+// Times the CPU side of the world (generation, meshing, raycasts,
+// entity collisions, mob ticks, entity queries, relighting, noise,
+// Chunk lookups, streaming Chunks in and out, and meshing snapshots of
+// Chunks while they are edited) on a fixed-seed world without any window or GL context, and writes the
+// results out as JSON.
+class CoreBenchmark
+{
+private:
+    CoreBenchmarkOptions m_options;
+    bool m_failed; // Set when a correctness check fails
+
+    // The world-space x-z extent of the benchmark world, [min, max)
+    int worldMin() const;
+    int worldMax() const;
+
+    // Generates the whole benchmark world into terrain, sampling
+    // biomes every biomeStep blocks (the configured step if 0)
+    void generateWorld(Terrain *terrain, int biomeStep = 0) const;
+
+    // Each suite writes one JSON object to out
+    void runGeneration(std::ostream &out);
+    void runMeshing(std::ostream &out);
+    void runRaycast(std::ostream &out);
+    void runRaycast(std::ostream &out, const Terrain &terrain, const char *name, float length);
+    void runCollision(std::ostream &out);
+    void runMobs(std::ostream &out);
+    void runSpatial(std::ostream &out);
+    void runSpatial(std::ostream &out, int entityCount);
+    void runLighting(std::ostream &out);
+    void runDeterminism(std::ostream &out);
+    void runNoise(std::ostream &out);
+    void runLookup(std::ostream &out);
+    void runStreaming(std::ostream &out);
+    void runSnapshot(std::ostream &out);
+
+public:
+    CoreBenchmark(const CoreBenchmarkOptions &options);
+
+    // Runs every configured suite and writes the results to out.
+    // Returns false if any of the correctness checks failed.
+    bool run(std::ostream &out);
+};
+
+// Parses the command line, runs the benchmark and
+// returns the process exit code
+int runCoreBenchmark(int argc, char *argv[]);
@@ -0,0 +1,8 @@
+#include "corebenchmark.h"
+
+// Headless benchmark of the world core (see corebenchmark.h), e.g.
+// corebenchmark --suite all --repeat 10 --output core.json
+int main(int argc, char *argv[])
+{
+    return runCoreBenchmark(argc, argv);
+}
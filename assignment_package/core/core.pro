@@ -0,0 +1,9 @@
+# The world core: everything needed to generate, edit, mesh and raycast
+# the world. Nothing in here may depend on Qt or OpenGL.
+TARGET = minecraftcore
+TEMPLATE = lib
+CONFIG += staticlib
+CONFIG -= qt
+
+include(../common.pri)
+include(../src/core.pri)
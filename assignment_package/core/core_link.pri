@@ -0,0 +1,12 @@
+# Include this from any sub-project that links against the world core
+INCLUDEPATH += $$PWD/../src $$PWD/../src/scene
+DEPENDPATH += $$PWD/../src $$PWD/../src/scene
+
+win32:CONFIG(release, debug|release): CORE_DIR = $$OUT_PWD/../core/release
+else:win32:CONFIG(debug, debug|release): CORE_DIR = $$OUT_PWD/../core/debug
+else: CORE_DIR = $$OUT_PWD/../core
+
+LIBS += -L$$CORE_DIR -lminecraftcore
+
+win32-g++|!win32: PRE_TARGETDEPS += $$CORE_DIR/libminecraftcore.a
+else: PRE_TARGETDEPS += $$CORE_DIR/minecraftcore.lib
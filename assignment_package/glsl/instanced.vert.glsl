@@ -21,6 +21,8 @@ out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+out vec2 fs_Light;          // Instances are always lit as if under the open sky
+out float fs_AO;            // and never occluded
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
@@ -32,6 +34,8 @@ void main()
     fs_Col = vec4(vs_ColInstanced, 1.);                         // Pass the vertex colors to the fragment shader for interpolation
 
     fs_Nor = vs_Nor;
+    fs_Light = vec2(1, 0);
+    fs_AO = 1.;
 
     fs_LightVec = (lightDir);  // Compute the direction in which the light source lies
 
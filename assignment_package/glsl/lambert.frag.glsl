@@ -19,10 +19,18 @@ in vec4 fs_Pos;
 in vec4 fs_Nor;
 in vec4 fs_LightVec;
 in vec4 fs_Col;
+in vec2 fs_Light; // Sky and block light, from 0 to 1
+in float fs_AO;   // Ambient occlusion, from 0 (enclosed corner) to 1 (open)
 
 out vec4 out_Col; // This is the final output color that you will see on your
                   // screen for the pixel that is currently being processed.
 
+// Turns a light level from 0 to 1 into a brightness. As in Minecraft,
+// each of the 16 levels is 80% as bright as the one above it.
+float brightness(float level) {
+    return pow(0.8, 15.0 * (1.0 - level));
+}
+
 float random1(vec3 p) {
     return fract(sin(dot(p,vec3(127.1, 311.7, 191.999)))
                  *43758.5453);
@@ -72,7 +80,7 @@ void main()
 {
     // Material base color (before shading)
         vec4 diffuseColor = fs_Col;
-        diffuseColor = diffuseColor * (0.5 * fbm(fs_Pos.xyz) + 0.5);
+        diffuseColor.rgb = diffuseColor.rgb * (0.5 * fbm(fs_Pos.xyz) + 0.5); // Leave alpha alone for translucent blocks
 
         // Calculate the diffuse term for Lambert shading
         float diffuseTerm = dot(normalize(fs_Nor), normalize(fs_LightVec));
@@ -85,6 +93,13 @@ void main()
                                                             //to simulate ambient lighting. This ensures that faces that are not
                                                             //lit by our point light are not completely black.
 
+        // The sun only reaches as far as the sky light does. Block light
+        // (e.g. from lava) shines the same in every direction.
+        lightIntensity = max(lightIntensity * brightness(fs_Light.x), brightness(fs_Light.y));
+
+        // Corners hemmed in by blocks receive less of both
+        lightIntensity *= mix(0.45, 1.0, fs_AO);
+
         // Compute final shaded color
         out_Col = vec4(diffuseColor.rgb * lightIntensity, diffuseColor.a);
 }
@@ -28,10 +28,19 @@ in vec4 vs_Nor;             // The array of vertex normals passed to the shader
 
 in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
+in vec2 vs_UV;              // The texture atlas coordinates of each vertex (only used by textured.frag.glsl)
+
+in vec2 vs_Light;           // The sky and block light levels of each vertex, from 0 to 1
+
+in float vs_AO;             // The ambient occlusion of each vertex, from 0 (enclosed) to 1 (open)
+
 out vec4 fs_Pos;
 out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
 out vec4 fs_LightVec;       // The direction in which our virtual light lies, relative to each vertex. This is implicitly passed to the fragment shader.
 out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+out vec2 fs_UV;             // The texture atlas coordinates of each vertex.
+out vec2 fs_Light;          // The sky and block light levels of each vertex.
+out float fs_AO;            // The ambient occlusion of each vertex.
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
@@ -40,6 +49,9 @@ void main()
 {
     fs_Pos = vs_Pos;
     fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
+    fs_UV = vs_UV;
+    fs_Light = vs_Light;
+    fs_AO = vs_AO;
 
     mat3 invTranspose = mat3(u_ModelInvTr);
     fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
@@ -0,0 +1,51 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// A cheaper alternative to lambert.frag.glsl: instead of evaluating
+// procedural FBM noise for every fragment, the block's surface detail
+// is read with a single (mipmapped) lookup into the texture atlas.
+// It uses the same vertex shader, lambert.vert.glsl.
+
+uniform sampler2D u_Texture; // The block texture atlas
+
+in vec4 fs_Pos;
+in vec4 fs_Nor;
+in vec4 fs_LightVec;
+in vec4 fs_Col;
+in vec2 fs_Light; // Sky and block light, from 0 to 1
+in float fs_AO;   // Ambient occlusion, from 0 (enclosed corner) to 1 (open)
+in vec2 fs_UV;
+
+out vec4 out_Col;
+
+// Turns a light level from 0 to 1 into a brightness. As in Minecraft,
+// each of the 16 levels is 80% as bright as the one above it.
+float brightness(float level) {
+    return pow(0.8, 15.0 * (1.0 - level));
+}
+
+void main()
+{
+    // Material base color (before shading). The vertex color only
+    // contributes its alpha, which marks translucent blocks.
+    vec4 diffuseColor = vec4(texture(u_Texture, fs_UV).rgb, fs_Col.a);
+
+    // Calculate the diffuse term for Lambert shading
+    float diffuseTerm = dot(normalize(fs_Nor), normalize(fs_LightVec));
+    // Avoid negative lighting values
+    diffuseTerm = clamp(diffuseTerm, 0, 1);
+
+    float ambientTerm = 0.2;
+
+    float lightIntensity = diffuseTerm + ambientTerm;
+
+    // The sun only reaches as far as the sky light does. Block light
+    // (e.g. from lava) shines the same in every direction.
+    lightIntensity = max(lightIntensity * brightness(fs_Light.x), brightness(fs_Light.y));
+
+    // Corners hemmed in by blocks receive less of both
+    lightIntensity *= mix(0.45, 1.0, fs_AO);
+
+    // Compute final shaded color
+    out_Col = vec4(diffuseColor.rgb * lightIntensity, diffuseColor.a);
+}
@@ -0,0 +1,39 @@
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/scene/blocktype.cpp \
+    $$PWD/scene/direction.cpp \
+    $$PWD/scene/noise.cpp \
+    $$PWD/scene/terrain.cpp \
+    $$PWD/scene/chunk.cpp \
+    $$PWD/scene/chunkmap.cpp \
+    $$PWD/scene/chunkpool.cpp \
+    $$PWD/scene/chunksnapshot.cpp \
+    $$PWD/scene/collision.cpp \
+    $$PWD/scene/lighting.cpp \
+    $$PWD/scene/mobsystem.cpp \
+    $$PWD/scene/spatialhash.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/threadpool.cpp
+
+HEADERS += \
+    $$PWD/scene/blocktype.h \
+    $$PWD/scene/direction.h \
+    $$PWD/scene/noise.h \
+    $$PWD/scene/terrain.h \
+    $$PWD/scene/chunk.h \
+    $$PWD/scene/chunkmap.h \
+    $$PWD/scene/chunkpool.h \
+    $$PWD/scene/chunksnapshot.h \
+    $$PWD/scene/meshbuffer.h \
+    $$PWD/scene/faceshading.h \
+    $$PWD/scene/collision.h \
+    $$PWD/scene/lighting.h \
+    $$PWD/scene/mobsystem.h \
+    $$PWD/scene/spatialhash.h \
+    $$PWD/smartpointerhelp.h \
+    $$PWD/glm_includes.h \
+    $$PWD/profiler.h \
+    $$PWD/quadindices.h \
+    $$PWD/threadpool.h
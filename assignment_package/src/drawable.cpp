@@ -1,9 +1,11 @@
 #include "drawable.h"
 #include <glm_includes.h>
 
-Drawable::Drawable(OpenGLContext* context)
+Drawable::Drawable(OpenGLFunctions* context)
     : m_count(-1), m_bufIdx(), m_bufPos(), m_bufNor(), m_bufCol(), m_bufInterleaved(),
+      m_countTransparent(-1), m_bufIdxTransparent(), m_bufInterleavedTransparent(),
       m_idxGenerated(false), m_posGenerated(false), m_norGenerated(false), m_colGenerated(false),
+      m_interleavedGenerated(false), m_idxTransparentGenerated(false), m_interleavedTransparentGenerated(false),
       mp_context(context)
 {}
 
@@ -18,9 +20,13 @@ void Drawable::destroyVBOdata()
     mp_context->glDeleteBuffers(1, &m_bufNor);
     mp_context->glDeleteBuffers(1, &m_bufCol);
     mp_context->glDeleteBuffers(1, &m_bufInterleaved);
+    mp_context->glDeleteBuffers(1, &m_bufIdxTransparent);
+    mp_context->glDeleteBuffers(1, &m_bufInterleavedTransparent);
 
     m_idxGenerated = m_posGenerated = m_norGenerated = m_colGenerated = m_interleavedGenerated = false;
+    m_idxTransparentGenerated = m_interleavedTransparentGenerated = false;
     m_count = -1;
+    m_countTransparent = -1;
 }
 
 GLenum Drawable::drawMode()
@@ -39,6 +45,11 @@ int Drawable::elemCount()
     return m_count;
 }
 
+int Drawable::elemCountTransparent()
+{
+    return m_countTransparent;
+}
+
 void Drawable::generateIdx()
 {
     m_idxGenerated = true;
@@ -74,6 +85,18 @@ void Drawable::generateInterleaved()
     mp_context->glGenBuffers(1, &m_bufInterleaved);
 }
 
+void Drawable::generateIdxTransparent()
+{
+    m_idxTransparentGenerated = true;
+    mp_context->glGenBuffers(1, &m_bufIdxTransparent);
+}
+
+void Drawable::generateInterleavedTransparent()
+{
+    m_interleavedTransparentGenerated = true;
+    mp_context->glGenBuffers(1, &m_bufInterleavedTransparent);
+}
+
 
 bool Drawable::bindIdx()
 {
@@ -115,8 +138,30 @@ bool Drawable::bindInterleaved()
     return m_interleavedGenerated;
 }
 
+bool Drawable::bindIdxTransparent()
+{
+    if(m_idxTransparentGenerated) {
+        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTransparent);
+    }
+    return m_idxTransparentGenerated;
+}
+
+bool Drawable::bindInterleavedTransparent()
+{
+    if(m_interleavedTransparentGenerated){
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInterleavedTransparent);
+    }
+    return m_interleavedTransparentGenerated;
+}
+
+GLenum Drawable::bindIndices(bool transparent)
+{
+    transparent ? bindIdxTransparent() : bindIdx();
+    return GL_UNSIGNED_INT;
+}
+
 
-InstancedDrawable::InstancedDrawable(OpenGLContext *context)
+InstancedDrawable::InstancedDrawable(OpenGLFunctions *context)
     : Drawable(context), m_numInstances(0), m_bufPosOffset(-1), m_offsetGenerated(false)
 {}
 
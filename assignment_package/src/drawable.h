@@ -15,19 +15,27 @@ protected:
                    // Instead, we use a uniform vec4 in the shader to set an overall color for the geometry
     GLuint m_bufInterleaved;
 
+    // A second index/interleaved buffer pair for geometry that has to be
+    // drawn in a separate, blended pass (e.g. the water faces of a Chunk).
+    int m_countTransparent;
+    GLuint m_bufIdxTransparent;
+    GLuint m_bufInterleavedTransparent;
+
     bool m_idxGenerated; // Set to TRUE by generateIdx(), returned by bindIdx().
     bool m_posGenerated;
     bool m_norGenerated;
     bool m_colGenerated;
     bool m_interleavedGenerated;
+    bool m_idxTransparentGenerated;
+    bool m_interleavedTransparentGenerated;
 
-    OpenGLContext* mp_context; // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
+    OpenGLFunctions* mp_context; // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                           // we need to pass our OpenGL context to the Drawable in order to call GL functions
                           // from within this class.
 
 
 public:
-    Drawable(OpenGLContext* mp_context);
+    Drawable(OpenGLFunctions* mp_context);
     virtual ~Drawable();
 
     virtual void createVBOdata() = 0; // To be implemented by subclasses. Populates the VBOs of the Drawable.
@@ -36,6 +44,7 @@ public:
     // Getter functions for various GL data
     virtual GLenum drawMode();
     int elemCount();
+    int elemCountTransparent();
 
     // Call these functions when you want to call glGenBuffers on the buffers stored in the Drawable
     // These will properly set the values of idxBound etc. which need to be checked in ShaderProgram::draw()
@@ -44,12 +53,21 @@ public:
     void generateNor();
     void generateCol();
     void generateInterleaved();
+    void generateIdxTransparent();
+    void generateInterleavedTransparent();
 
     bool bindIdx();
     bool bindPos();
     bool bindNor();
     bool bindCol();
     bool bindInterleaved();
+    bool bindIdxTransparent();
+    bool bindInterleavedTransparent();
+
+    // Binds the index buffer of the opaque or transparent geometry and
+    // returns the type of its indices. By default that is bufIdx or
+    // bufIdxTransparent, holding GLuints.
+    virtual GLenum bindIndices(bool transparent);
 
 };
 
@@ -66,7 +84,7 @@ protected:
     bool m_offsetGenerated;
 
 public:
-    InstancedDrawable(OpenGLContext* mp_context);
+    InstancedDrawable(OpenGLFunctions* mp_context);
     virtual ~InstancedDrawable();
     int instanceCount() const;
 
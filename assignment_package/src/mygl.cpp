@@ -1,17 +1,23 @@
 #include "mygl.h"
 #include <glm_includes.h>
 
+#include <cstdlib>
 #include <iostream>
 #include <QApplication>
 #include <QKeyEvent>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include "profiler.h"
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_worldAxes(this),
-      m_progLambert(this), m_progFlat(this), m_progInstanced(this),
-      m_terrain(this), m_player(glm::vec3(48.f, 129.f, 48.f), m_terrain),
-      prev_frametime(QDateTime::currentMSecsSinceEpoch())
+      m_progLambert(this), m_progFlat(this), m_progInstanced(this), m_progTextured(this),
+      m_textureAtlas(this), m_proceduralShading(false),
+      m_terrain(), m_terrainRenderer(this), m_player(glm::vec3(48.f, 129.f, 48.f), m_terrain),
+      m_threads(), m_mobs(&m_threads), m_mobCube(this), m_mobTickMs(0.f),
+      prev_frametime(QDateTime::currentMSecsSinceEpoch()),
+      m_renderStats(), m_samplesQuery(), m_samplesQueryIssued(false), m_samplesPassed()
 {
     // Connect the timer to a function so that when the timer ticks the function is executed
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
@@ -19,13 +25,32 @@ MyGL::MyGL(QWidget *parent)
     m_timer.start(16);
     setFocusPolicy(Qt::ClickFocus);
 
+    // Left clicking a mob despawns it
+    m_player.setEntities(&m_mobs.getSpatialHash());
+    m_terrain.setThreadPool(&m_threads);
+    m_terrainRenderer.setThreadPool(&m_threads);
+
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
     setCursor(Qt::BlankCursor); // Make the cursor invisible
+
+    // Every launch builds the same world unless MINIMINECRAFT_SEED picks another
+    if(const char *seed = std::getenv("MINIMINECRAFT_SEED")) {
+        m_terrain.setSeed(std::atoi(seed));
+    }
+    std::cout << "World seed: " << m_terrain.getSeed() << std::endl;
+
+    // Profile the first few seconds of the game if MINIMINECRAFT_PROFILE is set
+    Profiler::beginCaptureFromEnvironment();
 }
 
 MyGL::~MyGL() {
     makeCurrent();
     glDeleteVertexArrays(1, &vao);
+    glDeleteQueries(2, m_samplesQuery);
+    m_textureAtlas.destroy();
+    m_terrainRenderer.destroy();
+    m_mobCube.destroyVBOdata();
+    m_mobCube.clearOffsetBuf();
 }
 
 
@@ -53,14 +78,25 @@ void MyGL::initializeGL()
     // Create a Vertex Attribute Object
     glGenVertexArrays(1, &vao);
 
+    // Occlusion queries used to estimate how many fragments each terrain pass shades
+    glGenQueries(2, m_samplesQuery);
+
     //Create the instance of the world axes
     m_worldAxes.createVBOdata();
+    m_mobCube.createVBOdata();
 
     // Create and set up the diffuse shader
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
     // Create and set up the flat lighting shader
     m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
     m_progInstanced.create(":/glsl/instanced.vert.glsl", ":/glsl/lambert.frag.glsl");
+    // Create and set up the texture atlas shader, which shares lambert's vertex shader
+    m_progTextured.create(":/glsl/lambert.vert.glsl", ":/glsl/textured.frag.glsl");
+
+    // Atlas tiles are 16 x 16 texels, so past mip level 4 they would bleed into each other
+    m_textureAtlas.create(":/textures/minecraft_textures_all.png", 4);
+    m_textureAtlas.bind(0);
+    m_progTextured.setTextureSlot(0);
 
     // Set a color with which to draw geometry.
     // This will ultimately not be used when you change
@@ -85,6 +121,7 @@ void MyGL::resizeGL(int w, int h) {
 
     m_progLambert.setViewProjMatrix(viewproj);
     m_progFlat.setViewProjMatrix(viewproj);
+    m_progTextured.setViewProjMatrix(viewproj);
 
     printGLErrorLog();
 }
@@ -95,12 +132,27 @@ void MyGL::resizeGL(int w, int h) {
 // all per-frame actions here, such as performing physics updates on all
 // entities in the scene.
 void MyGL::tick() {
+    // Writes out the current profiler capture once its time is up
+    Profiler::update();
+
+    PROFILE_ZONE("MyGL::tick");
     //Compute the delta-time and store it as the previous one
     qint64 curr_frametime = QDateTime::currentMSecsSinceEpoch();
     qint64 delta = curr_frametime - prev_frametime;
     prev_frametime = curr_frametime;
 
     m_player.tick(delta, player_inputbundle);
+    int hitMob = m_player.takeHitEntity();
+    if(hitMob != -1) {
+        m_mobs.despawn(hitMob);
+    }
+
+    // Mobs work in seconds. Cap the step so a long stall
+    // doesn't launch them across the world.
+    QElapsedTimer mobTimer;
+    mobTimer.start();
+    m_mobs.tick(glm::min(delta, qint64(100)) / 1000.f, m_terrain);
+    m_mobTickMs = mobTimer.nsecsElapsed() / 1e6f;
 
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
     sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
@@ -117,20 +169,40 @@ void MyGL::sendPlayerDataToGUI() const {
     glm::ivec2 zone(64 * glm::ivec2(glm::floor(pPos / 64.f)));
     emit sig_sendPlayerChunk(QString::fromStdString("( " + std::to_string(chunk.x) + ", " + std::to_string(chunk.y) + " )"));
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
+
+    // Every fragment that passes the depth test runs the fragment shader, and since
+    // opaque Chunks are drawn front to back, early depth testing rejects nearly all
+    // of the hidden ones. The samples passed are therefore a good estimate of the
+    // number of fragment shader invocations, and dividing them by the number of
+    // pixels on screen gives the average overdraw.
+    float pixels = glm::max(1, width() * height());
+    float overdrawOpaque = m_samplesPassed[0] / pixels;
+    float overdrawTransparent = m_samplesPassed[1] / pixels;
+    emit sig_sendRenderStats(QString::fromStdString(std::to_string(m_renderStats.drawCalls) + " draws, " +
+                                                    std::to_string(m_renderStats.triangles / 1000) + "k tris, " +
+                                                    std::to_string((m_samplesPassed[0] + m_samplesPassed[1]) / 1000) + "k frags\n" +
+                                                    "overdraw " + QString::number(overdrawOpaque, 'f', 2).toStdString() + "x opaque + " +
+                                                    QString::number(overdrawTransparent, 'f', 2).toStdString() + "x translucent\n" +
+                                                    std::to_string(m_mobs.size()) + " mobs, " +
+                                                    QString::number(m_mobTickMs, 'f', 2).toStdString() + " ms tick on " +
+                                                    std::to_string(m_threads.threadCount()) + " threads"));
 }
 
 // This function is called whenever update() is called.
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
+    PROFILE_ZONE("MyGL::paintGL");
     // Clear the screen so that we only see newly drawn images
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
     m_progLambert.setViewProjMatrix(m_player.mcr_camera.getViewProj());
     m_progInstanced.setViewProjMatrix(m_player.mcr_camera.getViewProj());
+    m_progTextured.setViewProjMatrix(m_player.mcr_camera.getViewProj());
 
     renderTerrain();
+    renderMobs();
 
     glDisable(GL_DEPTH_TEST);
     m_progFlat.setModelMatrix(glm::mat4());
@@ -148,23 +220,51 @@ void MyGL::renderTerrain() {
 
     ivec2 corner = m_terrain.getTerrainCornerAt(pos.x, pos.z);
 
-    cout << "(" << corner.x << "," << corner.y << ")";
-
-    m_terrain.generateTerrain(corner.x, corner.y);
-    m_terrain.generateTerrain(corner.x - 64, corner.y);
-    m_terrain.generateTerrain(corner.x + 64, corner.y);
-    m_terrain.generateTerrain(corner.x, corner.y + 64);
-    m_terrain.generateTerrain(corner.x - 64, corner.y + 64);
-    m_terrain.generateTerrain(corner.x + 64, corner.y + 64);
-    m_terrain.generateTerrain(corner.x, corner.y - 64);
-    m_terrain.generateTerrain(corner.x - 64, corner.y - 64);
-    m_terrain.generateTerrain(corner.x + 64, corner.y - 64);
+    // Queue the nine zones around the player, plus one Chunk beyond them so
+    // the outermost drawn Chunks have every neighbor they need to be meshed.
+    // A batch of one Chunk per thread is generated each frame, nearest first.
+    m_terrain.requestChunks(corner.x - 80, corner.x + 144, corner.y - 80, corner.y + 144);
+    m_terrain.generateRequested(m_threads.threadCount(), pos);
+    // Chunks two zones beyond that go back to the pool, so roaming
+    // doesn't keep allocating
+    m_terrain.unloadChunksOutside(corner.x - 192, corner.x + 256, corner.y - 192, corner.y + 256);
+
+    // Read back last frame's fragment counts. By now the GPU is done with them,
+    // so this doesn't stall the pipeline the way reading this frame's would.
+    if (m_samplesQueryIssued) {
+        glGetQueryObjectuiv(m_samplesQuery[0], GL_QUERY_RESULT, &m_samplesPassed[0]);
+        glGetQueryObjectuiv(m_samplesQuery[1], GL_QUERY_RESULT, &m_samplesPassed[1]);
+    }
 
+    std::vector<Chunk*> chunks = m_terrain.getChunksFrontToBack(corner.x - 64, corner.x + 128,
+                                                                corner.y - 64, corner.y + 128,
+                                                                m_player.mcr_camera.mcr_position);
+    m_renderStats = RenderStats();
+    m_renderStats.samplesQuery[0] = m_samplesQuery[0];
+    m_renderStats.samplesQuery[1] = m_samplesQuery[1];
 
+    ShaderProgram *terrainProg = m_proceduralShading ? &m_progLambert : &m_progTextured;
+    m_terrainRenderer.draw(chunks, terrainProg, &m_renderStats);
 
-    m_terrain.draw(corner.x - 64, corner.x + 128, corner.y - 64, corner.y + 128, &m_progLambert);
+    m_samplesQueryIssued = true;
 }
 
+void MyGL::renderMobs() {
+    if(m_mobs.size() == 0) {
+        return;
+    }
+    PROFILE_ZONE("MyGL::renderMobs");
+
+    // The cube spans [0, 1], so shift each one to stand on its mob's position
+    const std::vector<glm::vec3> &positions = m_mobs.getPositions();
+    std::vector<glm::vec3> offsets(positions.size()), colors(positions.size());
+    for(int i = 0; i < m_mobs.size(); ++i) {
+        offsets[i] = positions[i] - glm::vec3(0.5f, 0.f, 0.5f);
+        colors[i] = m_mobs.isOnGround(i) ? glm::vec3(0.85f, 0.45f, 0.3f) : glm::vec3(0.95f, 0.8f, 0.3f);
+    }
+    m_mobCube.createInstancedVBOdata(offsets, colors);
+    m_progInstanced.drawInstanced(m_mobCube);
+}
 
 void MyGL::keyPressEvent(QKeyEvent *e) {
 
@@ -201,6 +301,27 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         m_player.toggleFlightMode();
     }
 
+    //Switch between placing stone and lava, which lights up its surroundings
+    if(e->key() == Qt::Key_L) {
+        m_player.togglePlacedBlock();
+    }
+
+    //Spawn 10,000 wandering mobs around the player to stress the MobSystem
+    if(e->key() == Qt::Key_M) {
+        m_mobs.spawnWanderers(m_terrain, m_player.mcr_position, 48.f, 10000,
+                              static_cast<uint32_t>(QDateTime::currentMSecsSinceEpoch()));
+    }
+
+    //Record a 5 second Chrome trace of the game's hot paths to trace.json
+    if(e->key() == Qt::Key_P && !Profiler::isCapturing()) {
+        Profiler::beginCapture(5.0, "trace.json");
+    }
+
+    //Toggle between the texture atlas and the procedural noise terrain shading
+    if(e->key() == Qt::Key_T) {
+        m_proceduralShading = !m_proceduralShading;
+    }
+
     float amount = 2.0f;
     if(e->modifiers() & Qt::ShiftModifier){
         amount = 10.0f;
@@ -3,10 +3,15 @@
 
 #include "openglcontext.h"
 #include "shaderprogram.h"
+#include "texture.h"
 #include "scene/worldaxes.h"
 #include "scene/camera.h"
 #include "scene/terrain.h"
+#include "scene/terrainrenderer.h"
 #include "scene/player.h"
+#include "scene/mobsystem.h"
+#include "scene/cube.h"
+#include "threadpool.h"
 
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
@@ -21,12 +26,21 @@ private:
     ShaderProgram m_progLambert;// A shader program that uses lambertian reflection
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
     ShaderProgram m_progInstanced;// A shader program that is designed to be compatible with instanced rendering
+    ShaderProgram m_progTextured;// A shader program that uses lambertian reflection on top of the block texture atlas
+
+    Texture m_textureAtlas; // The block texture atlas sampled by m_progTextured
+    bool m_proceduralShading; // If true, Chunks are drawn with m_progLambert's procedural noise instead of the atlas
 
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
                 // Don't worry too much about this. Just know it is necessary in order to render geometry.
 
     Terrain m_terrain; // All of the Chunks that currently comprise the world.
+    TerrainRenderer m_terrainRenderer; // Meshes, uploads and draws m_terrain's Chunks
     Player m_player; // The entity controlled by the user. Contains a camera to display what it sees as well.
+    ThreadPool m_threads; // Worker threads shared by terrain generation and the systems that tick the world
+    MobSystem m_mobs; // Every wandering mob in the world, ticked on m_threads
+    Cube m_mobCube; // Drawn once per mob with m_progInstanced
+    float m_mobTickMs; // How long the last MobSystem::tick took
     InputBundle m_inputs; // A collection of variables to be updated in keyPressEvent, mouseMoveEvent, mousePressEvent, etc.
 
     QTimer m_timer; // Timer linked to tick(). Fires approximately 60 times per second.
@@ -41,6 +55,11 @@ private:
 
     InputBundle player_inputbundle;
 
+    RenderStats m_renderStats; // Draw calls and triangles submitted by the last call to renderTerrain()
+    GLuint m_samplesQuery[2]; // GL_SAMPLES_PASSED queries wrapped around the opaque and translucent terrain passes
+    bool m_samplesQueryIssued;
+    GLuint m_samplesPassed[2]; // Results of the above queries, read back one frame late to avoid stalling
+
 
 public:
     explicit MyGL(QWidget *parent = nullptr);
@@ -58,8 +77,11 @@ public:
     void paintGL() override;
 
     // Called from paintGL().
-    // Calls Terrain::draw().
+    // Calls TerrainRenderer::draw().
     void renderTerrain();
+    // Called from paintGL().
+    // Draws every mob as an instance of m_mobCube.
+    void renderMobs();
 
 protected:
     // Automatically invoked when the user
@@ -85,6 +107,7 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    void sig_sendRenderStats(QString) const;
 };
 
 
@@ -69,7 +69,7 @@ void OpenGLContext::debugContextVersion()
     }
 }
 
-void OpenGLContext::printGLErrorLog()
+void OpenGLFunctions::printGLErrorLog()
 {
     GLenum error = glGetError();
     if (error != GL_NO_ERROR) {
@@ -91,7 +91,7 @@ void OpenGLContext::printGLErrorLog()
     }
 }
 
-void OpenGLContext::printLinkInfoLog(int prog)
+void OpenGLFunctions::printLinkInfoLog(int prog)
 {
     GLint linked;
     glGetProgramiv(prog, GL_LINK_STATUS, &linked);
@@ -117,7 +117,7 @@ void OpenGLContext::printLinkInfoLog(int prog)
     throw;
 }
 
-void OpenGLContext::printShaderInfoLog(int shader)
+void OpenGLFunctions::printShaderInfoLog(int shader)
 {
     GLint compiled;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
@@ -5,9 +5,24 @@
 #include <QOpenGLExtraFunctions>
 
 
+// The OpenGL function table (plus some error reporting helpers) that every
+// Drawable, ShaderProgram and Texture issues its GL calls through. It is
+// kept separate from the widget below so that the same geometry can also
+// be rendered into an offscreen surface, e.g. by RenderBenchmark.
+class OpenGLFunctions
+    : public QOpenGLExtraFunctions
+{
+
+public:
+    void printGLErrorLog();
+    void printLinkInfoLog(int prog);
+    void printShaderInfoLog(int shader);
+};
+
+
 class OpenGLContext
     : public QOpenGLWidget,
-      public QOpenGLExtraFunctions
+      public OpenGLFunctions
 {
 
 public:
@@ -15,7 +30,4 @@ public:
     ~OpenGLContext();
 
     void debugContextVersion();
-    void printGLErrorLog();
-    void printLinkInfoLog(int prog);
-    void printShaderInfoLog(int shader);
 };
@@ -35,4 +35,6 @@ void PlayerInfo::slot_setChunkText(QString s) {
 void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
-
+void PlayerInfo::slot_setRenderText(QString s) {
+    ui->renderLabel->setText(s);
+}
@@ -0,0 +1,195 @@
+#include "profiler.h"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Profiler::s_enabled(false);
+std::atomic<uint32_t> Profiler::s_generation(0);
+
+namespace {
+
+struct ProfileEvent {
+    const char *name;
+    int64_t start, end;
+};
+
+// A single-producer ring buffer of finished zones. Only its owning thread
+// writes to it; the exporter reads it after the capture has disabled the
+// profiler and every zone open on the thread has closed. Once full, the
+// oldest events are overwritten.
+struct ProfileBuffer {
+    static const uint64_t CAPACITY = 1 << 16; // Must be a power of two
+
+    std::array<ProfileEvent, CAPACITY> events;
+    std::atomic<uint64_t> written;
+    std::atomic<int> openZones; // Zones the thread has open while enabled
+    int threadId;
+
+    ProfileBuffer(int threadId) : events(), written(0), openZones(0), threadId(threadId)
+    {}
+};
+
+// Every thread's buffer, so the exporter can find them. Buffers are only
+// ever added (the first time a thread records a zone), never removed.
+std::mutex s_buffersMutex;
+std::vector<std::unique_ptr<ProfileBuffer>> s_buffers;
+
+ProfileBuffer *threadBuffer() {
+    thread_local ProfileBuffer *buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        s_buffers.push_back(std::make_unique<ProfileBuffer>(static_cast<int>(s_buffers.size())));
+        buffer = s_buffers.back().get();
+    }
+    return buffer;
+}
+
+// State of the current capture. Only touched from the main thread.
+int64_t s_captureStart = 0;
+int64_t s_captureEnd = 0;
+bool s_capturing = false;
+std::string s_captureOutput;
+
+} // namespace
+
+int64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char *name, int64_t start, int64_t end)
+{
+    ProfileBuffer *buffer = threadBuffer();
+    uint64_t i = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[i & (ProfileBuffer::CAPACITY - 1)] = {name, start, end};
+    buffer->written.store(i + 1, std::memory_order_release);
+}
+
+bool Profiler::openZone(uint32_t *generation)
+{
+    // Counting the zone before checking the flag again pairs with update()
+    // clearing the flag before checking the counts: either update() waits
+    // for this zone, or this zone sees that the capture has finished
+    ProfileBuffer *buffer = threadBuffer();
+    buffer->openZones.fetch_add(1);
+    if (!s_enabled.load()) {
+        buffer->openZones.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+    *generation = s_generation.load(std::memory_order_relaxed);
+    return true;
+}
+
+void Profiler::closeZone(const char *name, int64_t start, uint32_t generation)
+{
+    int64_t end = now();
+    ProfileBuffer *buffer = threadBuffer();
+    if (s_enabled.load() && s_generation.load(std::memory_order_relaxed) == generation) {
+        record(name, start, end);
+    }
+    buffer->openZones.fetch_sub(1, std::memory_order_release);
+}
+
+void Profiler::beginCapture(double seconds, const std::string &outputPath)
+{
+    s_captureStart = now();
+    s_captureEnd = s_captureStart + static_cast<int64_t>(seconds * 1e9);
+    s_captureOutput = outputPath;
+    s_capturing = true;
+    s_generation.fetch_add(1, std::memory_order_relaxed);
+    s_enabled.store(true);
+    std::cout << "Profiling for " << seconds << " s" << std::endl;
+}
+
+void Profiler::beginCaptureFromEnvironment()
+{
+    const char *seconds = std::getenv("MINIMINECRAFT_PROFILE");
+    if (seconds == nullptr || std::atof(seconds) <= 0) {
+        return;
+    }
+    const char *output = std::getenv("MINIMINECRAFT_PROFILE_OUTPUT");
+    beginCapture(std::atof(seconds), output != nullptr ? output : "trace.json");
+}
+
+bool Profiler::isCapturing()
+{
+    return s_capturing;
+}
+
+void Profiler::update()
+{
+    if (!s_capturing || now() < s_captureEnd) {
+        return;
+    }
+    s_enabled.store(false);
+    s_capturing = false;
+
+    // Zones open on other threads may still be recording. Those on this
+    // thread are suspended while it exports, and won't record once resumed.
+    ProfileBuffer *own = threadBuffer();
+    {
+        std::lock_guard<std::mutex> lock(s_buffersMutex);
+        for (auto &buffer : s_buffers) {
+            while (buffer.get() != own && buffer->openZones.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    std::ofstream file(s_captureOutput);
+    if (!file) {
+        std::cerr << "Could not write profile to " << s_captureOutput << std::endl;
+        return;
+    }
+    writeChromeTrace(file, s_captureStart);
+    std::cout << "Wrote profile to " << s_captureOutput << std::endl;
+}
+
+// Zone names are string literals from our own code, but escape them anyway
+static void writeJsonString(std::ostream &out, const char *s)
+{
+    out << '"';
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            out << '\\';
+        }
+        out << *s;
+    }
+    out << '"';
+}
+
+void Profiler::writeChromeTrace(std::ostream &out, int64_t since)
+{
+    std::lock_guard<std::mutex> lock(s_buffersMutex);
+
+    // Chrome traces use microseconds
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    for (auto &buffer : s_buffers) {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t oldest = written > ProfileBuffer::CAPACITY ? written - ProfileBuffer::CAPACITY : 0;
+        for (uint64_t i = oldest; i < written; ++i) {
+            const ProfileEvent &e = buffer->events[i & (ProfileBuffer::CAPACITY - 1)];
+            if (e.start < since) {
+                continue;
+            }
+            out << (first ? "\n" : ",\n") << "{\"name\": ";
+            writeJsonString(out, e.name);
+            out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadId
+                << ", \"ts\": " << (e.start - since) / 1000.0
+                << ", \"dur\": " << (e.end - e.start) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
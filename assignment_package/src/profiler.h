@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// A lightweight hierarchical-zone profiler for the game's hot paths.
+//
+// Wrap a scope with PROFILE_ZONE("name") to time it. When the profiler is
+// disabled (the default) a zone costs one relaxed atomic load and a branch.
+// When enabled, each zone appends one event to a fixed-size ring buffer
+// owned by the calling thread, so recording never locks or allocates.
+//
+// Each thread also counts the zones it has open. Finishing a capture
+// disables the profiler and then waits for the zones still open on other
+// threads, which no longer record anything, before reading their buffers.
+//
+// A capture enables the profiler for a fixed time window and then writes
+// every recorded event as a Chrome trace (JSON), which can be opened in
+// chrome://tracing or https://ui.perfetto.dev. A capture can be started
+// from code (e.g. a keypress in MyGL) or by setting the environment
+// variable MINIMINECRAFT_PROFILE to a number of seconds; the trace is
+// written to MINIMINECRAFT_PROFILE_OUTPUT (default "trace.json").
+//
+// Define MINIMINECRAFT_NO_PROFILER to compile every zone out entirely.
+class Profiler
+{
+private:
+    static std::atomic<bool> s_enabled;
+    // Incremented by every capture, so a zone that outlives the capture it
+    // was opened in isn't recorded into the next
+    static std::atomic<uint32_t> s_generation;
+
+public:
+    static bool isEnabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Nanoseconds on a monotonic clock
+    static int64_t now();
+    // Appends a finished zone to the calling thread's ring buffer
+    static void record(const char *name, int64_t start, int64_t end);
+    // Counts a zone as open on the calling thread and returns true, with
+    // the capture's generation, if the profiler is still enabled
+    static bool openZone(uint32_t *generation);
+    // Records a zone opened by openZone, unless its capture has finished
+    // since, and counts it as closed
+    static void closeZone(const char *name, int64_t start, uint32_t generation);
+
+    // Enables the profiler for the given number of seconds, after which
+    // update() writes the trace to outputPath and disables it again.
+    static void beginCapture(double seconds, const std::string &outputPath);
+    // Starts a capture if MINIMINECRAFT_PROFILE is set
+    static void beginCaptureFromEnvironment();
+    static bool isCapturing();
+    // Finishes the current capture once its time window has passed.
+    // Call this regularly (e.g. once per tick) from the main thread.
+    static void update();
+
+    // Writes every event recorded since the given time, from all threads.
+    // Only safe once no other thread can record, as update() makes sure.
+    static void writeChromeTrace(std::ostream &out, int64_t since);
+};
+
+// Times the enclosing scope while the profiler is enabled
+class ProfileZone
+{
+private:
+    const char *m_name; // Must be a string literal (or otherwise outlive the capture)
+    int64_t m_start;    // -1 if the zone isn't being timed
+    uint32_t m_generation;
+
+public:
+    explicit ProfileZone(const char *name)
+        : m_name(name), m_start(-1), m_generation(0)
+    {
+        if (Profiler::isEnabled() && Profiler::openZone(&m_generation)) {
+            m_start = Profiler::now();
+        }
+    }
+
+    ~ProfileZone() {
+        if (m_start >= 0) {
+            Profiler::closeZone(m_name, m_start, m_generation);
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef MINIMINECRAFT_NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
@@ -0,0 +1,80 @@
+#include "quadindexbuffer.h"
+#include <algorithm>
+#include <vector>
+#include "profiler.h"
+
+// The indices of the given number of quads
+template<typename T>
+static std::vector<T> quadIndices(int quads)
+{
+    std::vector<T> indices(6 * static_cast<size_t>(quads));
+    for (int q = 0; q < quads; q++) {
+        T first = static_cast<T>(4 * q);
+        T *tri = &indices[6 * static_cast<size_t>(q)];
+        tri[0] = first;
+        tri[1] = first + 1;
+        tri[2] = first + 2;
+        tri[3] = first;
+        tri[4] = first + 2;
+        tri[5] = first + 3;
+    }
+    return indices;
+}
+
+QuadIndexBuffer::QuadIndexBuffer(OpenGLFunctions *context)
+    : m_buf16(), m_buf32(), m_quads16(0), m_quads32(0), mp_context(context)
+{}
+
+template<typename T>
+void QuadIndexBuffer::grow(GLuint *buf, int *covered, int quads)
+{
+    if (quads <= *covered) {
+        return;
+    }
+    PROFILE_ZONE("Quad index upload");
+    int size = QuadIndices::coveredQuads(quads);
+    std::vector<T> indices = quadIndices<T>(size);
+    if (*covered == 0) {
+        mp_context->glGenBuffers(1, buf);
+    }
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *buf);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(T), indices.data(), GL_STATIC_DRAW);
+    *covered = size;
+}
+
+void QuadIndexBuffer::reserve(int quads)
+{
+    // The other half of a big mesh may still be small enough for 16-bit
+    // indices, so those always cover as much as they can of it
+    grow<GLushort>(&m_buf16, &m_quads16, std::min(quads, QuadIndices::MAX_QUADS_16));
+    if (quads > QuadIndices::MAX_QUADS_16) {
+        grow<GLuint>(&m_buf32, &m_quads32, quads);
+    }
+}
+
+GLenum QuadIndexBuffer::bind(int quads)
+{
+    if (quads <= QuadIndices::MAX_QUADS_16) {
+        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buf16);
+        return GL_UNSIGNED_SHORT;
+    }
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buf32);
+    return GL_UNSIGNED_INT;
+}
+
+size_t QuadIndexBuffer::byteSize() const
+{
+    return 6 * static_cast<size_t>(m_quads16) * sizeof(GLushort) + 6 * static_cast<size_t>(m_quads32) * sizeof(GLuint);
+}
+
+void QuadIndexBuffer::destroy()
+{
+    if (m_quads16 > 0) {
+        mp_context->glDeleteBuffers(1, &m_buf16);
+        m_quads16 = 0;
+    }
+    if (m_quads32 > 0) {
+        mp_context->glDeleteBuffers(1, &m_buf32);
+        m_quads32 = 0;
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <openglcontext.h>
+#include "quadindices.h"
+#include <cstddef>
+
+// The one index buffer every Chunk mesh is drawn with. Chunk faces are
+// quads of four consecutive vertices, each split into the triangles
+// 0, 1, 2 and 0, 2, 3 (see ChunkMesh), so the indices of every mesh are
+// the same sequence and only its length differs. Rather than each Chunk
+// uploading its own copy, this builds the sequence once and every draw
+// uses as much of it as its mesh needs.
+//
+// Meshes of up to 16384 quads (65536 vertices) use 16-bit indices, half
+// the size of 32-bit ones. The rare larger mesh uses a second, 32-bit
+// buffer. Each buffer is created when the first mesh that needs it turns
+// up, sized to the largest mesh reserved so far (see QuadIndices), and
+// uploaded again whenever a bigger one arrives.
+class QuadIndexBuffer
+{
+private:
+    GLuint m_buf16;
+    GLuint m_buf32;
+    int m_quads16; // Quads the 16-bit buffer covers, 0 until it is needed
+    int m_quads32; // Quads the 32-bit buffer covers, 0 until it is needed
+
+    OpenGLFunctions* mp_context;
+
+    // Makes the given buffer cover at least the given number of quads
+    template<typename T>
+    void grow(GLuint *buf, int *covered, int quads);
+
+public:
+    QuadIndexBuffer(OpenGLFunctions* context);
+
+    // Makes sure a mesh of the given number of quads can be drawn
+    void reserve(int quads);
+    // Binds the buffer to draw a mesh of the given number of quads
+    // with, which must have been reserved, and returns its index type
+    GLenum bind(int quads);
+
+    // GPU memory held by the shared indices
+    size_t byteSize() const;
+    void destroy();
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// How big the shared quad index buffers are (see QuadIndexBuffer), kept
+// apart from OpenGL so the benchmark reports the same sizes the renderer
+// allocates.
+class QuadIndices
+{
+public:
+    // The most quads 16-bit indices can address
+    static const int MAX_QUADS_16 = 16384;
+    // The buffers grow in steps of this many quads, so a mesh that keeps
+    // growing a little doesn't upload them again every time
+    static const int QUADS_STEP = 1024;
+
+    // How many quads a buffer grown to fit the given number of them covers
+    static int coveredQuads(int quads) {
+        return (quads + QUADS_STEP - 1) / QUADS_STEP * QUADS_STEP;
+    }
+
+    // The bytes both buffers hold once the largest mesh reserved has the
+    // given number of quads
+    static size_t byteSize(int largestQuads) {
+        size_t bytes = 6 * static_cast<size_t>(coveredQuads(std::min(largestQuads, MAX_QUADS_16))) * sizeof(uint16_t);
+        if (largestQuads > MAX_QUADS_16) {
+            bytes += 6 * static_cast<size_t>(coveredQuads(largestQuads)) * sizeof(uint32_t);
+        }
+        return bytes;
+    }
+};
@@ -0,0 +1,278 @@
+#include "renderbenchmark.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+// The benchmark flies around the same 3 x 3 terrain generation zones
+// that MyGL draws when the player stands in the zone at (0, 0)
+static const int WORLD_MIN = -64;
+static const int WORLD_MAX = 128;
+
+RenderBenchmark::RenderBenchmark(const RenderBenchmarkOptions &options)
+    : m_options(options), m_surface(), m_context(), mp_fbo(nullptr), m_gl(),
+      m_progLambert(&m_gl), m_progTextured(&m_gl), m_textureAtlas(&m_gl), vao(),
+      m_terrain(), m_terrainRenderer(&m_gl), m_camera(options.width, options.height, glm::vec3(0.f))
+{}
+
+RenderBenchmark::~RenderBenchmark()
+{
+    if (m_context.isValid() && m_context.makeCurrent(&m_surface)) {
+        m_gl.glDeleteVertexArrays(1, &vao);
+        m_textureAtlas.destroy();
+        m_terrainRenderer.destroy();
+        mp_fbo = nullptr;
+        m_context.doneCurrent();
+    }
+}
+
+bool RenderBenchmark::initialize()
+{
+    m_surface.setFormat(QSurfaceFormat::defaultFormat());
+    m_surface.create();
+    m_context.setFormat(QSurfaceFormat::defaultFormat());
+    if (!m_context.create() || !m_context.makeCurrent(&m_surface)) {
+        std::cerr << "Could not create an offscreen OpenGL context" << std::endl;
+        return false;
+    }
+    m_gl.initializeOpenGLFunctions();
+
+    std::cerr << "Benchmarking on " << m_gl.glGetString(GL_RENDERER)
+              << " (" << m_gl.glGetString(GL_VERSION) << ")" << std::endl;
+
+    mp_fbo = mkU<QOpenGLFramebufferObject>(QSize(m_options.width, m_options.height),
+                                           QOpenGLFramebufferObject::Depth);
+    if (!mp_fbo->isValid()) {
+        std::cerr << "Could not create a " << m_options.width << " x " << m_options.height
+                  << " framebuffer" << std::endl;
+        return false;
+    }
+    mp_fbo->bind();
+    m_gl.glViewport(0, 0, m_options.width, m_options.height);
+
+    // Same GL state as MyGL::initializeGL
+    m_gl.glEnable(GL_DEPTH_TEST);
+    m_gl.glClearColor(0.37f, 0.74f, 1.0f, 1);
+    m_gl.glGenVertexArrays(1, &vao);
+    m_gl.glBindVertexArray(vao);
+
+    m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
+    m_progTextured.create(":/glsl/lambert.vert.glsl", ":/glsl/textured.frag.glsl");
+    m_textureAtlas.create(":/textures/minecraft_textures_all.png", 4);
+    m_textureAtlas.bind(0);
+    m_progTextured.setTextureSlot(0);
+
+    // Generate (and mesh) the whole flight area up front so that
+    // generation time doesn't leak into the frame times
+    QElapsedTimer timer;
+    timer.start();
+    m_terrain.setSeed(m_options.seed);
+    // One more Chunk on each side, so that the outermost drawn ones can be meshed
+    m_terrain.generateArea(WORLD_MIN - 16, WORLD_MAX + 16, WORLD_MIN - 16, WORLD_MAX + 16);
+    m_terrainRenderer.updateDrawables(m_terrain.getChunksFrontToBack(WORLD_MIN, WORLD_MAX, WORLD_MIN, WORLD_MAX,
+                                                                     glm::vec3(0.f)));
+    std::cerr << "Generated and meshed terrain in " << timer.elapsed() << " ms" << std::endl;
+
+    m_gl.printGLErrorLog();
+    return true;
+}
+
+void RenderBenchmark::placeCamera(int frame, int frameCount)
+{
+    // One full orbit around the center of the world, high above the
+    // terrain and looking ahead and down so the view covers both nearby
+    // and distant Chunks, water and mountains
+    const glm::vec3 center(32.f, 175.f, 32.f);
+    const float radius = 56.f;
+    float angle = glm::radians(360.f) * frame / frameCount;
+    float ahead = angle + glm::radians(40.f);
+    glm::vec3 eye = center + radius * glm::vec3(glm::cos(angle), 0.f, glm::sin(angle));
+    glm::vec3 target = glm::vec3(32.f, 135.f, 32.f) + radius * glm::vec3(glm::cos(ahead), 0.f, glm::sin(ahead));
+    m_camera.lookAt(eye, target);
+}
+
+// Escapes the characters that may not appear unescaped in a JSON string
+static std::string jsonString(const std::string &s)
+{
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// The value below which the given fraction of the sorted values lie
+static double percentile(std::vector<double> sorted, double fraction)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+}
+
+void RenderBenchmark::run(std::ostream &out)
+{
+    std::vector<std::pair<std::string, ShaderProgram*>> modes;
+    if (m_options.texturedShading) modes.push_back({"textured", &m_progTextured});
+    if (m_options.proceduralShading) modes.push_back({"procedural", &m_progLambert});
+
+    const int frames = m_options.frames;
+    const float pixels = static_cast<float>(m_options.width) * m_options.height;
+
+    TerrainMemoryStats memory = m_terrainRenderer.getMemoryStats();
+    std::cerr << "Terrain meshes: " << memory.vertexBytes << " bytes of vertices, " << memory.sharedIndexBytes
+              << " bytes of shared indices (" << memory.perChunkIndexBytes << " with an index buffer per Chunk)" << std::endl;
+
+    out << "{\n"
+        << "  \"benchmark\": \"render\",\n"
+        << "  \"renderer\": " << jsonString(reinterpret_cast<const char*>(m_gl.glGetString(GL_RENDERER))) << ",\n"
+        << "  \"gl_version\": " << jsonString(reinterpret_cast<const char*>(m_gl.glGetString(GL_VERSION))) << ",\n"
+        << "  \"width\": " << m_options.width << ",\n"
+        << "  \"height\": " << m_options.height << ",\n"
+        << "  \"seed\": " << m_options.seed << ",\n"
+        << "  \"frames\": " << frames << ",\n"
+        << "  \"memory\": {\"vertex_bytes\": " << memory.vertexBytes
+        << ", \"shared_index_bytes\": " << memory.sharedIndexBytes
+        << ", \"per_chunk_index_bytes\": " << memory.perChunkIndexBytes
+        << ", \"uploads\": " << memory.uploads
+        << ", \"uploaded_vertex_bytes\": " << memory.uploadedVertexBytes
+        << ", \"upload_index_bytes_saved\": " << memory.uploadIndexBytesSaved << "},\n"
+        << "  \"modes\": [";
+
+    for (size_t m = 0; m < modes.size(); ++m) {
+        ShaderProgram *prog = modes[m].second;
+
+        // One GPU timer and two fragment counters per frame. Results are
+        // only read back after the last frame so that measuring doesn't
+        // serialize the CPU and GPU.
+        std::vector<GLuint> timeQueries(frames), samplesQueries(2 * frames);
+        m_gl.glGenQueries(frames, timeQueries.data());
+        m_gl.glGenQueries(2 * frames, samplesQueries.data());
+        std::vector<double> cpuMs(frames);
+        std::vector<RenderStats> stats(frames);
+
+        QElapsedTimer timer;
+        for (int i = -m_options.warmupFrames; i < frames; ++i) {
+            bool measured = i >= 0;
+            placeCamera(glm::max(i, 0), frames);
+
+            timer.start();
+            if (measured) m_gl.glBeginQuery(GL_TIME_ELAPSED, timeQueries[i]);
+
+            m_gl.glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            prog->setViewProjMatrix(m_camera.getViewProj());
+            std::vector<Chunk*> chunks = m_terrain.getChunksFrontToBack(WORLD_MIN, WORLD_MAX, WORLD_MIN, WORLD_MAX,
+                                                                        m_camera.mcr_position);
+            RenderStats frameStats;
+            if (measured) {
+                frameStats.samplesQuery[0] = samplesQueries[2 * i];
+                frameStats.samplesQuery[1] = samplesQueries[2 * i + 1];
+            }
+            m_terrainRenderer.draw(chunks, prog, &frameStats);
+
+            if (measured) {
+                m_gl.glEndQuery(GL_TIME_ELAPSED);
+                cpuMs[i] = timer.nsecsElapsed() / 1e6;
+                stats[i] = frameStats;
+            } else {
+                // Let warmup frames finish so they don't overlap the measured ones
+                m_gl.glFinish();
+            }
+        }
+        m_gl.glFinish();
+
+        std::vector<double> gpuMs(frames);
+        std::vector<GLuint> samples(2 * frames);
+        for (int i = 0; i < frames; ++i) {
+            GLuint ns = 0;
+            m_gl.glGetQueryObjectuiv(timeQueries[i], GL_QUERY_RESULT, &ns);
+            gpuMs[i] = ns / 1e6;
+            m_gl.glGetQueryObjectuiv(samplesQueries[2 * i], GL_QUERY_RESULT, &samples[2 * i]);
+            m_gl.glGetQueryObjectuiv(samplesQueries[2 * i + 1], GL_QUERY_RESULT, &samples[2 * i + 1]);
+        }
+        m_gl.glDeleteQueries(frames, timeQueries.data());
+        m_gl.glDeleteQueries(2 * frames, samplesQueries.data());
+        m_gl.printGLErrorLog();
+
+        double cpuMean = std::accumulate(cpuMs.begin(), cpuMs.end(), 0.0) / frames;
+        double gpuMean = std::accumulate(gpuMs.begin(), gpuMs.end(), 0.0) / frames;
+        double overdrawMean = std::accumulate(samples.begin(), samples.end(), 0.0) / pixels / frames;
+        std::cerr << modes[m].first << ": cpu " << cpuMean << " ms, gpu " << gpuMean
+                  << " ms, overdraw " << overdrawMean << "x per frame" << std::endl;
+
+        out << (m == 0 ? "\n" : ",\n")
+            << "    {\n"
+            << "      \"shading\": " << jsonString(modes[m].first) << ",\n"
+            << "      \"summary\": {\"cpu_ms_mean\": " << cpuMean
+            << ", \"cpu_ms_p95\": " << percentile(cpuMs, 0.95)
+            << ", \"gpu_ms_mean\": " << gpuMean
+            << ", \"gpu_ms_p95\": " << percentile(gpuMs, 0.95)
+            << ", \"overdraw_mean\": " << overdrawMean << "},\n"
+            << "      \"frames\": [";
+        for (int i = 0; i < frames; ++i) {
+            out << (i == 0 ? "\n" : ",\n")
+                << "        {\"frame\": " << i
+                << ", \"cpu_ms\": " << cpuMs[i]
+                << ", \"gpu_ms\": " << gpuMs[i]
+                << ", \"draw_calls\": " << stats[i].drawCalls
+                << ", \"triangles\": " << stats[i].triangles
+                << ", \"samples_opaque\": " << samples[2 * i]
+                << ", \"samples_translucent\": " << samples[2 * i + 1] << "}";
+        }
+        out << "\n      ]\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int runRenderBenchmark(int argc, char *argv[])
+{
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders a scripted camera path offscreen and reports per-frame timings as JSON.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("benchmark", "Run the offscreen rendering benchmark."));
+    parser.addOption(QCommandLineOption("frames", "Measured frames per shading mode.", "count", "600"));
+    parser.addOption(QCommandLineOption("warmup", "Unmeasured frames rendered before each mode.", "count", "30"));
+    parser.addOption(QCommandLineOption("width", "Framebuffer width.", "pixels", "1280"));
+    parser.addOption(QCommandLineOption("height", "Framebuffer height.", "pixels", "720"));
+    parser.addOption(QCommandLineOption("seed", "World seed.", "seed", "1337"));
+    parser.addOption(QCommandLineOption("shading", "Shading modes to measure: textured, procedural or both.", "mode", "both"));
+    parser.addOption(QCommandLineOption("output", "Write the JSON report to this file instead of stdout.", "file"));
+    parser.process(app);
+
+    RenderBenchmarkOptions options;
+    options.frames = glm::max(1, parser.value("frames").toInt());
+    options.warmupFrames = glm::max(0, parser.value("warmup").toInt());
+    options.width = glm::max(1, parser.value("width").toInt());
+    options.height = glm::max(1, parser.value("height").toInt());
+    options.seed = parser.value("seed").toInt();
+    QString shading = parser.value("shading");
+    options.texturedShading = shading == "both" || shading == "textured";
+    options.proceduralShading = shading == "both" || shading == "procedural";
+
+    RenderBenchmark benchmark(options);
+    if (!benchmark.initialize()) {
+        return 1;
+    }
+
+    if (parser.isSet("output")) {
+        std::ofstream file(parser.value("output").toStdString());
+        if (!file) {
+            std::cerr << "Could not open " << parser.value("output").toStdString() << std::endl;
+            return 1;
+        }
+        benchmark.run(file);
+    } else {
+        benchmark.run(std::cout);
+    }
+    return 0;
+}
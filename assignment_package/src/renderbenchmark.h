@@ -0,0 +1,72 @@
+#pragma once
+
+#include "openglcontext.h"
+#include "shaderprogram.h"
+#include "texture.h"
+#include "scene/terrain.h"
+#include "scene/terrainrenderer.h"
+#include "scene/camera.h"
+#include <smartpointerhelp.h>
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <ostream>
+
+// Settings for a RenderBenchmark run, parsed from the command line
+struct RenderBenchmarkOptions {
+    int frames;            // Number of measured frames per shading mode
+    int warmupFrames;      // Frames rendered (but not measured) before each mode
+    int width, height;     // Size of the offscreen framebuffer
+    int seed;              // World seed, so every run renders the same terrain
+    bool texturedShading;  // Measure the texture atlas shading path
+    bool proceduralShading;// Measure the procedural FBM shading path
+
+    RenderBenchmarkOptions()
+        : frames(600), warmupFrames(30), width(1280), height(720), seed(1337),
+          texturedShading(true), proceduralShading(true)
+    {}
+};
+
+// Renders the terrain into an offscreen framebuffer, without any window,
+// while flying the camera along a fixed path over a fixed-seed world.
+// For each frame it records the CPU time spent submitting it, the GPU
+// time spent drawing it, the draw calls and triangles submitted and the
+// fragments shaded, then writes everything out as JSON. Its results are
+// the baseline against which rendering changes are compared.
+class RenderBenchmark
+{
+private:
+    RenderBenchmarkOptions m_options;
+
+    QOffscreenSurface m_surface;
+    QOpenGLContext m_context;
+    uPtr<QOpenGLFramebufferObject> mp_fbo;
+    OpenGLFunctions m_gl; // Resolved against m_context once it is current
+
+    ShaderProgram m_progLambert;
+    ShaderProgram m_progTextured;
+    Texture m_textureAtlas;
+    GLuint vao;
+
+    Terrain m_terrain;
+    TerrainRenderer m_terrainRenderer;
+    Camera m_camera;
+
+    // Positions the camera for the given frame of the scripted path
+    void placeCamera(int frame, int frameCount);
+
+public:
+    RenderBenchmark(const RenderBenchmarkOptions &options);
+    ~RenderBenchmark();
+
+    // Creates the GL context, framebuffer, shaders and world.
+    // Returns false (after printing why) if that isn't possible.
+    bool initialize();
+    // Renders every configured shading mode and writes the results to out
+    void run(std::ostream &out);
+};
+
+// Parses the command line of a "--benchmark" run, runs the
+// benchmark and returns the process exit code
+int runRenderBenchmark(int argc, char *argv[]);
@@ -14,9 +14,12 @@
 // Enum value DEFINITIONS
 // The initialization occurs in the scope of the class,
 // so the private BlockType constructor can be used.
-const BlockType BlockType::EMPTY = BlockType(0, "empty", false, vec3(1,1,1));
-const BlockType BlockType::GRASS = BlockType(1, "grass", true,  vec3(95.f, 159.f, 53.f) / 255.f);
-const BlockType BlockType::DIRT  = BlockType(2, "dirt", true,  vec3(121.f, 85.f, 58.f) / 255.f);
-const BlockType BlockType::STONE = BlockType(3, "stone", true,  vec3(0.5f));
-const BlockType BlockType::WATER = BlockType(4, "water", true,  vec3(0.f, 0.f, 0.75f));
-const BlockType BlockType::SNOW  = BlockType(5, "snow", true, vec3(1,1,1));
+const BlockType BlockType::EMPTY = BlockType(0, "empty", false, vec3(1,1,1), ivec2(0,0), ivec2(0,0), ivec2(0,0));
+const BlockType BlockType::GRASS = BlockType(1, "grass", true,  vec3(95.f, 159.f, 53.f) / 255.f, ivec2(3,0), ivec2(8,2), ivec2(2,0));
+const BlockType BlockType::DIRT  = BlockType(2, "dirt", true,  vec3(121.f, 85.f, 58.f) / 255.f, ivec2(2,0), ivec2(2,0), ivec2(2,0));
+const BlockType BlockType::STONE = BlockType(3, "stone", true,  vec3(0.5f), ivec2(1,0), ivec2(1,0), ivec2(1,0));
+const BlockType BlockType::WATER = BlockType(4, "water", false, vec3(0.f, 0.f, 0.75f), ivec2(13,12), ivec2(13,12), ivec2(13,12), 0.6f);
+const BlockType BlockType::SNOW  = BlockType(5, "snow", true, vec3(1,1,1), ivec2(2,4), ivec2(2,4), ivec2(2,4));
+const BlockType BlockType::LAVA  = BlockType(6, "lava", true, vec3(0.9f, 0.35f, 0.05f), ivec2(13,14), ivec2(13,14), ivec2(13,14), 1.f, 15);
+const BlockType BlockType::WOOD  = BlockType(7, "wood", true, vec3(0.4f, 0.3f, 0.18f), ivec2(4,1), ivec2(5,1), ivec2(5,1));
+const BlockType BlockType::LEAVES = BlockType(8, "leaves", true, vec3(0.2f, 0.5f, 0.15f), ivec2(5,3), ivec2(5,3), ivec2(5,3));
@@ -18,6 +18,9 @@ class BlockType {
     static const BlockType STONE;
     static const BlockType WATER;
     static const BlockType SNOW;
+    static const BlockType LAVA;
+    static const BlockType WOOD;
+    static const BlockType LEAVES;
 
     BlockType() : index(0), name("undefined")
     {}
@@ -27,26 +30,55 @@ class BlockType {
     std::string name;
     bool opaque = true;
     vec3 color = vec3(1.f, 0.f, 1.f); //purple default color
+    float alpha = 1.f; // only used by translucent (non-opaque, non-empty) blocks
+    int emission = 0; // block light level given off, 0 to 15
+    // Texture atlas tiles (column, row counted from the top left of
+    // minecraft_textures_all.png) used for the sides, top and bottom
+    ivec2 tileSide, tileTop, tileBottom;
 
   private:
-    BlockType(int index, std::string name, bool opaque, vec3 color) : index(index), name(name), opaque(opaque), color(color)
+    BlockType(int index, std::string name, bool opaque, vec3 color, ivec2 tileSide, ivec2 tileTop, ivec2 tileBottom, float alpha = 1.f, int emission = 0)
+        : index(index), name(name), opaque(opaque), color(color), alpha(alpha), emission(emission), tileSide(tileSide), tileTop(tileTop), tileBottom(tileBottom)
     {}
 //    BlockType(int index, bool opaque, vec3 color);
 
   public:
 
-    static constexpr int length() {return 5;}
+    static constexpr int length() {return 9;}
     constexpr operator int() const { return index; }
 
-    bool isOpaque(){
+    bool isOpaque() const{
         return opaque;
     }
 
-    vec3 getColor(){
+    // Visible, but lets the blocks behind it show through (e.g. water).
+    // These are meshed separately and drawn after all opaque geometry.
+    bool isTranslucent() const{
+        return !opaque && index != 0;
+    }
+
+    float getAlpha() const{
+        return alpha;
+    }
+
+    // How much block light this block gives off (e.g. lava), 0 to 15
+    int getLightEmission() const{
+        return emission;
+    }
+
+    // The lower-left UV corner of the atlas tile for the face with the
+    // given normal. The atlas is 16 x 16 tiles and is uploaded flipped
+    // vertically, so V is measured from the bottom of the image.
+    vec2 getUV(ivec3 normal) const{
+        ivec2 tile = normal.y > 0 ? tileTop : normal.y < 0 ? tileBottom : tileSide;
+        return vec2(tile.x, 15 - tile.y) / 16.f;
+    }
+
+    vec3 getColor() const{
         return color;
     }
 
-    std::string getName(){
+    std::string getName() const{
         return name;
     }
 
@@ -28,6 +28,13 @@ void Camera::setWidthHeight(unsigned int w, unsigned int h) {
 }
 
 
+void Camera::lookAt(glm::vec3 eye, glm::vec3 target) {
+    m_position = eye;
+    m_forward = glm::normalize(target - eye);
+    m_right = glm::normalize(glm::cross(m_forward, glm::vec3(0, 1, 0)));
+    m_up = glm::cross(m_right, m_forward);
+}
+
 void Camera::tick(float dT, InputBundle &input) {
     // Do nothing
 }
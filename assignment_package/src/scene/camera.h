@@ -18,6 +18,8 @@ public:
     Camera(unsigned int w, unsigned int h, glm::vec3 pos);
     Camera(const Camera &c);
     void setWidthHeight(unsigned int w, unsigned int h);
+    // Places the camera at eye, looking towards target with world up as up
+    void lookAt(glm::vec3 eye, glm::vec3 target);
 
     void tick(float dT, InputBundle &input) override;
 
@@ -1,13 +1,92 @@
 #include "chunk.h"
+#include "faceshading.h"
 
+#include <algorithm>
 #include <iostream>
+#include "profiler.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace std;
 using namespace glm;
 
-Chunk::Chunk(OpenGLContext* mp_context) : Drawable(mp_context), m_blocks(), m_neighbors{{Direction::XPOS, nullptr}, {Direction::XNEG, nullptr}, {Direction::ZPOS, nullptr}, {Direction::ZNEG, nullptr}}
+ChunkMesh::ChunkMesh()
+    : vertices(), verticesTransparent(), visibleFaces(), columnMasks(), allocations(0)
+{}
+
+void ChunkMesh::clear() {
+    vertices.clear();
+    verticesTransparent.clear();
+    visibleFaces.clear();
+    columnMasks.clear();
+}
+
+void ChunkMesh::reserveFaces(size_t opaque, size_t translucent) {
+    allocations += vertices.reserve(FLOATS_PER_FACE * opaque);
+    allocations += verticesTransparent.reserve(FLOATS_PER_FACE * translucent);
+}
+
+int ChunkMesh::faceCount() const {
+    return static_cast<int>(vertices.size() / FLOATS_PER_FACE);
+}
+
+int ChunkMesh::faceCountTransparent() const {
+    return static_cast<int>(verticesTransparent.size() / FLOATS_PER_FACE);
+}
+
+ChunkMesh& ChunkMesh::scratch() {
+    thread_local ChunkMesh mesh;
+    return mesh;
+}
+
+ChunkSection::ChunkSection() : blocks(), light()
+{
+    std::fill_n(blocks.begin(), 4096, BlockType::EMPTY);
+    light.fill(0);
+}
+
+Chunk::Chunk(int x, int z) : m_sections(), m_lightSources(0), m_surfaceHeights(), m_biomeWeights(), m_terrainHeights(), m_stage(ChunkStage::EMPTY), m_usedSections(0), m_neighbors{{Direction::XPOS, nullptr}, {Direction::XNEG, nullptr}, {Direction::ZPOS, nullptr}, {Direction::ZNEG, nullptr}}, m_origin(x, z), m_revision(0)
 {
-    std::fill_n(m_blocks.begin(), 65536, BlockType::EMPTY);
+    for (auto &section : m_sections) {
+        section = mkS<ChunkSection>();
+    }
+    m_surfaceHeights.fill(-1);
+    m_biomeWeights.fill(0.f);
+    m_terrainHeights.fill(0);
+}
+
+void Chunk::reset(int x, int z) {
+    for (int s = 0; s < 16; ++s) {
+        if (m_sections[s].use_count() > 1) {
+            // A snapshot still holds the old blocks
+            m_sections[s] = mkS<ChunkSection>();
+        } else {
+            if (m_usedSections & (1u << s)) {
+                std::fill_n(m_sections[s]->blocks.begin(), 4096, BlockType::EMPTY);
+            }
+            m_sections[s]->light.fill(0);
+        }
+    }
+    m_usedSections = 0;
+    m_lightSources = 0;
+    m_surfaceHeights.fill(-1);
+    m_biomeWeights.fill(0.f);
+    m_terrainHeights.fill(0);
+    m_stage = ChunkStage::EMPTY;
+    for (auto &neighbor : m_neighbors) {
+        neighbor.second = nullptr;
+    }
+    m_origin = ivec2(x, z);
+    m_revision++;
+}
+
+ivec2 Chunk::getOrigin() const {
+    return m_origin;
+}
+
+uint64_t Chunk::getRevision() const {
+    return m_revision;
 }
 
 // Does bounds checking with at()
@@ -32,7 +111,7 @@ BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) cons
         return this->m_neighbors.at(Direction::ZPOS)->getBlockAt(x, y, z - 16);
     }
 
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+    return m_sections.at(y >> 4)->blocks.at(x + 16 * (y & 15) + 256 * z);
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -67,7 +146,21 @@ BlockType Chunk::getBlockAt(ivec3 pos) const {
 
 // Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    BlockType &b = writableSection(y >> 4).blocks.at(x + 16 * (y & 15) + 256 * z);
+    m_lightSources += (t.getLightEmission() > 0) - (b.getLightEmission() > 0);
+    b = t;
+    m_revision++;
+
+    int16_t &surface = m_surfaceHeights[x + 16 * z];
+    if (t != BlockType::EMPTY) {
+        m_usedSections |= 1u << (y >> 4);
+        surface = std::max(surface, static_cast<int16_t>(y));
+    } else if (static_cast<int>(y) == surface) {
+        // The top block was removed, so find the next one down
+        while (surface >= 0 && isEmptyAt(x, static_cast<unsigned int>(surface), z)) {
+            surface--;
+        }
+    }
 }
 
 //const static Direction all_directions[] = { XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG };
@@ -95,82 +188,424 @@ void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     if(neighbor != nullptr) {
         this->m_neighbors[dir] = neighbor.get();
         neighbor->m_neighbors[*dir.opposite] = this;
+        // Faces along the shared border may now be hidden
+        this->m_revision++;
+        neighbor->m_revision++;
     }
 }
 
-void addToVector(vector<float> &vec, vec2 v){
-    vec.push_back(v.x);
-    vec.push_back(v.y);
+void Chunk::unlinkNeighbors() {
+    for(auto &neighbor : m_neighbors) {
+        if(neighbor.second != nullptr) {
+            neighbor.second->m_neighbors[*neighbor.first.opposite] = nullptr;
+            neighbor.second->m_revision++;
+            neighbor.second = nullptr;
+        }
+    }
+    m_revision++;
 }
 
-void addToVector(vector<float> &vec, vec3 v){
-    vec.push_back(v.x);
-    vec.push_back(v.y);
-    vec.push_back(v.z);
+Chunk* Chunk::getNeighbor(const Direction &dir) const {
+    return m_neighbors.at(dir);
 }
 
-void addToVector(vector<float> &vec, vec4 v){
-    vec.push_back(v.x);
-    vec.push_back(v.y);
-    vec.push_back(v.z);
-    vec.push_back(v.w);
+ChunkSection& Chunk::writableSection(int s) {
+    sPtr<ChunkSection> &section = m_sections[s];
+    if (section.use_count() > 1) {
+        section = mkS<ChunkSection>(*section);
+    }
+    return *section;
 }
 
-void addToVector(vector<float> &vec, ivec3 v){
-    vec.push_back(v.x);
-    vec.push_back(v.y);
-    vec.push_back(v.z);
+const BlockType& Chunk::blockAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return m_sections[y >> 4]->blocks[x + 16 * (y & 15) + 256 * z];
 }
 
+bool Chunk::isOpaqueAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return blockAt(x, y, z).isOpaque();
+}
 
-void Chunk::createVBOdata()
-{
-    vector<float> buffer;
-    vector<GLuint> idx;
+bool Chunk::isOpaqueAt(ivec3 pos) const {
+    if (pos.y < 0 || pos.y > 255) {
+        return false;
+    }
+    const Chunk *c = chunkHolding(&pos.x, &pos.z);
+    return c != nullptr && c->isOpaqueAt(static_cast<unsigned int>(pos.x), static_cast<unsigned int>(pos.y),
+                                         static_cast<unsigned int>(pos.z));
+}
 
-    int elem_count = 0;
+bool Chunk::isEmptyAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return blockAt(x, y, z) == BlockType::EMPTY;
+}
 
-    for (int x = 0; x < 16; x++){
-        for (int y = 0; y < 256; y++){
-            for (int z = 0; z < 16; z++){
-                ivec3 pos(x,y,z);
-                BlockType b = getBlockAt(pos);
-                if(b.isOpaque()){
-                    for (auto d : Direction::all){
-                        if(!getBlockAt(pos + d->vector).isOpaque()){
-                            //generate idx
-                            int initial = elem_count;
-
-                            int count = 0;
-                            for (auto v : d->vertices) {
-                                addToVector(buffer, v.pos + vec4(pos, 0));
-                                addToVector(buffer, vec4(d->vector, 1));
-                                addToVector(buffer, vec4(b.getColor(),0));
-                                count++;
-                                elem_count++;
-                            }
+int Chunk::getLightEmissionAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return blockAt(x, y, z).getLightEmission();
+}
+
+bool Chunk::hasLightSources() const {
+    return m_lightSources > 0;
+}
+
+int Chunk::getSurfaceHeight(unsigned int x, unsigned int z) const {
+    return m_surfaceHeights[x + 16 * z];
+}
+
+float Chunk::getBiomeWeight(unsigned int x, unsigned int z) const {
+    return m_biomeWeights[x + 16 * z];
+}
+
+void Chunk::setBiomeWeight(unsigned int x, unsigned int z, float weight) {
+    m_biomeWeights[x + 16 * z] = weight;
+}
+
+int Chunk::getTerrainHeight(unsigned int x, unsigned int z) const {
+    return m_terrainHeights[x + 16 * z];
+}
 
+void Chunk::setTerrainHeight(unsigned int x, unsigned int z, int height) {
+    m_terrainHeights[x + 16 * z] = static_cast<int16_t>(height);
+}
+
+ChunkStage Chunk::getStage() const {
+    return m_stage;
+}
+
+void Chunk::setStage(ChunkStage stage) {
+    m_stage = stage;
+}
+
+bool Chunk::isReadyToMesh() const {
+    if (m_stage != ChunkStage::LIT) {
+        return false;
+    }
+    // The diagonal neighbors are reached through the ones along x
+    for (const Direction *dx : {&Direction::XPOS, &Direction::XNEG}) {
+        const Chunk *side = m_neighbors.at(*dx);
+        if (side == nullptr || side->m_stage != ChunkStage::LIT) {
+            return false;
+        }
+        for (const Direction *dz : {&Direction::ZPOS, &Direction::ZNEG}) {
+            const Chunk *corner = side->m_neighbors.at(*dz);
+            if (corner == nullptr || corner->m_stage != ChunkStage::LIT) {
+                return false;
+            }
+        }
+    }
+    for (const Direction *dz : {&Direction::ZPOS, &Direction::ZNEG}) {
+        const Chunk *side = m_neighbors.at(*dz);
+        if (side == nullptr || side->m_stage != ChunkStage::LIT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t Chunk::getSkyLightAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return m_sections[y >> 4]->light[x + 16 * (y & 15) + 256 * z] >> 4;
+}
 
-                            for (int i = initial; i < initial + count - 2; i++){
-                                idx.push_back(initial);
-                                idx.push_back(i + 1);
-                                idx.push_back(i + 2);
+uint8_t Chunk::getBlockLightAt(unsigned int x, unsigned int y, unsigned int z) const {
+    return m_sections[y >> 4]->light[x + 16 * (y & 15) + 256 * z] & 0x0F;
+}
+
+void Chunk::setSkyLightAt(unsigned int x, unsigned int y, unsigned int z, uint8_t level) {
+    uint8_t &light = writableSection(y >> 4).light[x + 16 * (y & 15) + 256 * z];
+    light = static_cast<uint8_t>((light & 0x0F) | (level << 4));
+}
+
+void Chunk::setBlockLightAt(unsigned int x, unsigned int y, unsigned int z, uint8_t level) {
+    uint8_t &light = writableSection(y >> 4).light[x + 16 * (y & 15) + 256 * z];
+    light = static_cast<uint8_t>((light & 0xF0) | level);
+}
+
+const Chunk* Chunk::chunkHolding(int *x, int *z) const {
+    const Chunk *c = this;
+    if (*x < 0) {
+        c = m_neighbors.at(Direction::XNEG);
+        *x += 16;
+    } else if (*x > 15) {
+        c = m_neighbors.at(Direction::XPOS);
+        *x -= 16;
+    }
+    if (c != nullptr && *z < 0) {
+        c = c->m_neighbors.at(Direction::ZNEG);
+        *z += 16;
+    } else if (c != nullptr && *z > 15) {
+        c = c->m_neighbors.at(Direction::ZPOS);
+        *z -= 16;
+    }
+    return c;
+}
+
+uint8_t Chunk::getPackedLightAt(int x, int y, int z) const {
+    if (y > 255) {
+        return 0xF0;
+    }
+    if (y < 0) {
+        return 0;
+    }
+    const Chunk *c = chunkHolding(&x, &z);
+    if (c == nullptr) {
+        return 0xF0;
+    }
+    return c->m_sections[y >> 4]->light[x + 16 * (y & 15) + 256 * z];
+}
+
+uint64_t Chunk::contentHash() const {
+    // In the order x + 16 * y + 4096 * z, as before Chunks had sections
+    uint64_t hash = 14695981039346656037ull;
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 256; y++) {
+            const ChunkSection &section = *m_sections[y >> 4];
+            for (int x = 0; x < 16; x++) {
+                int i = x + 16 * (y & 15) + 256 * z;
+                hash = (hash ^ static_cast<uint8_t>(static_cast<int>(section.blocks[i]))) * 1099511628211ull;
+                hash = (hash ^ section.light[i]) * 1099511628211ull;
+            }
+        }
+    }
+    return hash;
+}
+
+void Chunk::markChanged() {
+    m_revision++;
+}
+
+// Appends the four vertices of one block face to the given buffer, which must have
+// room for them. Each vertex is laid out as position (vec4), normal (vec4), color (vec4),
+// atlas UV (vec2), light (vec2), ambient occlusion (float). ao holds the occlusion level
+// (0 to 3) of each of the face's vertices.
+static void addFace(MeshBuffer<float> &buffer, ivec3 pos, const Direction *d, vec4 color,
+                    vec2 uv, vec2 light, const array<int, 4> &ao){
+    // The quad is split along the diagonal from its first vertex. Choose
+    // the diagonal between its two brightest opposite corners: otherwise a
+    // single dark corner would be smeared across both triangles, and the
+    // shading would change with the face's orientation.
+    int first = ao[0] + ao[2] >= ao[1] + ao[3] ? 0 : 1;
+
+    float *out = buffer.append(ChunkMesh::FLOATS_PER_FACE);
+    for (int corner = 0; corner < 4; corner++) {
+        int i = (first + corner) % 4;
+        const VertexInfo &v = d->vertices[i];
+        out[0] = v.pos.x + pos.x;
+        out[1] = v.pos.y + pos.y;
+        out[2] = v.pos.z + pos.z;
+        out[3] = v.pos.w;
+        out[4] = d->vector.x;
+        out[5] = d->vector.y;
+        out[6] = d->vector.z;
+        out[7] = 1;
+        out[8] = color.r;
+        out[9] = color.g;
+        out[10] = color.b;
+        out[11] = color.a;
+        out[12] = uv.x + v.uv.x;
+        out[13] = uv.y + v.uv.y;
+        out[14] = light.x;
+        out[15] = light.y;
+        out[16] = ao[i] / 3.f;
+        out += ChunkMesh::FLOATS_PER_VERTEX;
+    }
+}
+
+// Classic three-neighbor ambient occlusion for the four vertices of a face.
+// Each vertex is darkened by the opaque blocks among the two blocks beside it
+// and the one diagonal to it, all in the layer of blocks in front of the face.
+// A vertex between two opaque side blocks is fully occluded whatever the
+// diagonal holds.
+array<int, 4> faceAO(const Chunk *chunk, ivec3 pos, const Direction *d) {
+    ivec3 front = pos + d->vector;
+    // The two axes along the face
+    int u = d->vector.x != 0 ? 1 : 0;
+    int v = d->vector.z != 0 ? 1 : 2;
+
+    // The eight blocks around front in the plane of the face, indexed by
+    // (du + 1) + 3 * (dv + 1), with the middle one left unused
+    bool opaque[9];
+    for (int dv = -1; dv <= 1; dv++) {
+        for (int du = -1; du <= 1; du++) {
+            ivec3 p = front;
+            p[u] += du;
+            p[v] += dv;
+            opaque[(du + 1) + 3 * (dv + 1)] = (du != 0 || dv != 0) && chunk->isOpaqueAt(p);
+        }
+    }
+
+    array<int, 4> ao;
+    for (int i = 0; i < 4; i++) {
+        // Each vertex of the face sits at 0 or 1 along both axes
+        int du = d->vertices[i].pos[u] > 0.5f ? 1 : -1;
+        int dv = d->vertices[i].pos[v] > 0.5f ? 1 : -1;
+        bool side1 = opaque[(du + 1) + 3];
+        bool side2 = opaque[1 + 3 * (dv + 1)];
+        bool corner = opaque[(du + 1) + 3 * (dv + 1)];
+        ao[i] = side1 && side2 ? 0 : 3 - (side1 + side2 + corner);
+    }
+    return ao;
+}
+
+// The light a face is lit by: that of the block in front of it,
+// or the light the block itself gives off if that is brighter
+vec2 faceLight(const Chunk *chunk, ivec3 pos, const Direction *d, const BlockType &b) {
+    ivec3 front = pos + d->vector;
+    uint8_t light = chunk->getPackedLightAt(front.x, front.y, front.z);
+    int blockLight = glm::max(light & 0x0F, b.getLightEmission());
+    return vec2(light >> 4, blockLight) / 15.f;
+}
+
+// The masks findVisibleFaces works with are four words per column, bit y
+// for the block at height y, for columns -1 to 16 along x and z
+static const int MASK_WORDS = 4;
+static const int MASK_COLUMNS = 18 * 18;
+
+static uint64_t* columnMask(uint64_t *masks, int slot, int x, int z) {
+    return masks + MASK_WORDS * (slot * MASK_COLUMNS + (x + 1) * 18 + (z + 1));
+}
+
+// The index of the lowest set bit of a nonzero word
+static int lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+void Chunk::findVisibleFaces(ChunkMesh *mesh, size_t *opaqueFaces, size_t *translucentFaces) const
+{
+    // Slot 0 holds the opaque blocks, and each translucent block type
+    // gets a slot of its own the first time it is seen, since faces
+    // between two blocks of the same translucent type (e.g. inside a
+    // lake) can never be seen but those between different ones can
+    const int maxSlots = 1 + BlockType::length();
+    mesh->allocations += mesh->columnMasks.reserve(MASK_WORDS * MASK_COLUMNS * maxSlots);
+    uint64_t *masks = mesh->columnMasks.append(MASK_WORDS * MASK_COLUMNS * maxSlots);
+    std::fill_n(masks, MASK_WORDS * MASK_COLUMNS, 0);
+    std::array<int, BlockType::length()> slotOf;
+    slotOf.fill(-1);
+    int slots = 1;
+
+    auto mark = [&](const BlockType &b, int x, int y, int z) {
+        int slot = 0;
+        if (!b.isOpaque()) {
+            if (!b.isTranslucent()) {
+                return;
+            }
+            slot = slotOf[b];
+            if (slot < 0) {
+                slot = slotOf[b] = slots++;
+                std::fill_n(columnMask(masks, slot, -1, -1), MASK_WORDS * MASK_COLUMNS, 0);
+            }
+        }
+        columnMask(masks, slot, x, z)[y >> 6] |= uint64_t(1) << (y & 63);
+    };
+
+    for (int z = 0; z < 16; z++) {
+        for (int y = 0; y < 256; y++) {
+            for (int x = 0; x < 16; x++) {
+                mark(blockAt(x, y, z), x, y, z);
+            }
+        }
+    }
+    // The border columns of the four neighbors. Missing neighbors are
+    // empty, as getBlockAt treats them.
+    for (const Direction *d : {&Direction::XPOS, &Direction::XNEG, &Direction::ZPOS, &Direction::ZNEG}) {
+        const Chunk *neighbor = m_neighbors.at(*d);
+        if (neighbor == nullptr) {
+            continue;
+        }
+        for (int along = 0; along < 16; along++) {
+            // The border column in this Chunk's coordinates, and the same column in the neighbor's
+            int x = d->vector.x > 0 ? 16 : d->vector.x < 0 ? -1 : along;
+            int z = d->vector.z > 0 ? 16 : d->vector.z < 0 ? -1 : along;
+            int nx = (x + 16) % 16, nz = (z + 16) % 16;
+            for (int y = 0; y < 256; y++) {
+                mark(neighbor->blockAt(nx, y, nz), x, y, z);
+            }
+        }
+    }
+
+    mesh->allocations += mesh->visibleFaces.reserve(65536);
+    uint8_t *visible = mesh->visibleFaces.append(65536);
+    std::fill_n(visible, 65536, 0);
+    *opaqueFaces = *translucentFaces = 0;
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            for (size_t i = 0; i < Direction::all.size(); i++) {
+                const ivec3 &v = Direction::all[i]->vector;
+                const uint64_t *opaque = columnMask(masks, 0, x, z);
+                const uint64_t *opaqueNext = columnMask(masks, 0, x + v.x, z + v.z);
+                for (int slot = 0; slot < slots; slot++) {
+                    const uint64_t *blocks = columnMask(masks, slot, x, z);
+                    const uint64_t *next = columnMask(masks, slot, x + v.x, z + v.z);
+                    for (int w = 0; w < MASK_WORDS; w++) {
+                        // Bit y of covering is set if the block in front of
+                        // the face of block y hides it. Above and below, that
+                        // is the neighboring bit of the same column; blocks
+                        // above or below the world never hide anything.
+                        uint64_t covering;
+                        if (v.y > 0) {
+                            covering = (opaque[w] >> 1) | (w + 1 < MASK_WORDS ? opaque[w + 1] << 63 : 0);
+                            if (slot > 0) {
+                                covering |= (blocks[w] >> 1) | (w + 1 < MASK_WORDS ? blocks[w + 1] << 63 : 0);
+                            }
+                        } else if (v.y < 0) {
+                            covering = (opaque[w] << 1) | (w > 0 ? opaque[w - 1] >> 63 : 0);
+                            if (slot > 0) {
+                                covering |= (blocks[w] << 1) | (w > 0 ? blocks[w - 1] >> 63 : 0);
                             }
+                        } else {
+                            covering = opaqueNext[w] | (slot > 0 ? next[w] : 0);
+                        }
+                        size_t &count = slot == 0 ? *opaqueFaces : *translucentFaces;
+                        for (uint64_t faces = blocks[w] & ~covering; faces != 0; faces &= faces - 1) {
+                            int y = 64 * w + lowestBit(faces);
+                            visible[x + 16 * y + 16 * 256 * z] |= 1 << i;
+                            count++;
                         }
                     }
                 }
             }
         }
     }
+}
 
-    this->m_count = idx.size();
-
-    generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+// Opaque and translucent blocks are meshed into separate buffers so that
+// the renderer can draw all opaque geometry first (front to back) and then
+// blend the translucent geometry on top of it (back to front).
+void Chunk::createMeshData(ChunkMesh *mesh) const
+{
+    PROFILE_ZONE("Chunk::createMeshData");
+    mesh->clear();
 
-    generateInterleaved();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInterleaved);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), buffer.data(), GL_STATIC_DRAW);
+    // Find every visible face first, so the buffers can be sized once
+    // and the vertices stored straight into them
+    size_t opaqueFaces, translucentFaces;
+    findVisibleFaces(mesh, &opaqueFaces, &translucentFaces);
+    const uint8_t *visible = mesh->visibleFaces.data();
+    mesh->reserveFaces(opaqueFaces, translucentFaces);
 
+    for (int x = 0; x < 16; x++){
+        for (int y = 0; y < 256; y++){
+            for (int z = 0; z < 16; z++){
+                uint8_t faces = visible[x + 16 * y + 16 * 256 * z];
+                if(faces == 0){
+                    continue;
+                }
+                ivec3 pos(x,y,z);
+                const BlockType &b = blockAt(x, y, z);
+                bool opaque = b.isOpaque();
+                vec4 color(b.getColor(), opaque ? 1.f : b.getAlpha());
+                for (size_t i = 0; i < Direction::all.size(); i++){
+                    if(faces & (1 << i)){
+                        const Direction *d = Direction::all[i];
+                        addFace(opaque ? mesh->vertices : mesh->verticesTransparent, pos, d, color,
+                                b.getUV(d->vector), faceLight(this, pos, d, b), faceAO(this, pos, d));
+                    }
+                }
+            }
+        }
+    }
 }
@@ -2,12 +2,14 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include <array>
+#include <vector>
 #include <unordered_map>
 #include <cstddef>
+#include <cstdint>
 
-#include "drawable.h"
 #include "blocktype.h"
 #include "direction.h"
+#include "meshbuffer.h"
 
 //using namespace std;
 
@@ -35,31 +37,209 @@ struct EnumHash {
     }
 };
 
+// How far terrain generation has got with a Chunk. Terrain runs each
+// stage over a whole batch of Chunks before starting the next one.
+enum class ChunkStage : unsigned char {
+    EMPTY,     // Just instantiated
+    HEIGHTMAP, // Biome weight and terrain height chosen for every column
+    FILLED,    // Every column filled with blocks up to its height
+    DECORATED, // Features (trees, boulders) placed, including those of
+               // earlier decorated neighbors that reached into it
+    LIT        // Light spread through it and into its lit neighbors
+};
+
+// The CPU-side mesh of one Chunk, ready to be uploaded into the interleaved
+// buffers of a Drawable. Each vertex is laid out as position (vec4),
+// normal (vec4), color (vec4), atlas UV (vec2), light (vec2: sky, block,
+// each from 0 to 1), ambient occlusion (float: 0 for a fully enclosed
+// corner, 1 for an open one).
+//
+// A mesh only lives until it is uploaded, so rather than every drawable
+// keeping its own, meshes are built into one scratch ChunkMesh per thread
+// (see scratch()). Its buffers grow to fit the largest Chunk meshed on
+// that thread and are then reused, so re-meshing stops allocating.
+//
+// Every face is a quad of four consecutive vertices, ordered so that it is
+// always split into triangles 0, 1, 2 and 0, 2, 3. Meshes therefore carry
+// no indices of their own: the renderer draws them all with one shared
+// index buffer of that pattern (see QuadIndexBuffer).
+struct ChunkMesh {
+    static constexpr int FLOATS_PER_VERTEX = 17;
+    static constexpr int FLOATS_PER_FACE = 4 * FLOATS_PER_VERTEX;
+    static constexpr int INDICES_PER_FACE = 6;
+
+    MeshBuffer<float> vertices;
+    // Translucent faces, drawn in a separate blended pass
+    MeshBuffer<float> verticesTransparent;
+    // The visible faces of each block, one bit per Direction::all entry,
+    // found by createMeshData before it writes any vertices
+    MeshBuffer<uint8_t> visibleFaces;
+    // Scratch for Chunk::findVisibleFaces: 256-bit masks (four words)
+    // of the 18 x 18 columns of a Chunk and the border around it
+    MeshBuffer<uint64_t> columnMasks;
+    // How many times any of the buffers has had to allocate
+    int allocations;
+
+    ChunkMesh();
+
+    void clear();
+    // Makes room for the given numbers of opaque and translucent faces
+    void reserveFaces(size_t opaque, size_t translucent);
+    int faceCount() const;
+    int faceCountTransparent() const;
+
+    // The calling thread's scratch mesh
+    static ChunkMesh& scratch();
+};
+
+// Sixteen layers of a Chunk's blocks (y from 16s to 16s + 15 for section
+// s) and their light, indexed x + 16 * (y % 16) + 256 * z. A section may be
+// shared between its Chunk and any number of ChunkSnapshots, so it is never
+// written while shared: the Chunk copies it first (see writableSection).
+struct ChunkSection {
+    std::array<BlockType, 4096> blocks;
+    // Sky light in the high four bits and block light in the low four
+    std::array<uint8_t, 4096> light;
+
+    ChunkSection();
+};
+
 // One Chunk is a 16 x 256 x 16 section of the world,
 // containing all the Minecraft blocks in that area.
 // We divide the world into Chunks in order to make
 // recomputing its VBO data faster by not having to
 // render all the world at once, while also not having
 // to render the world block by block.
+//
+// Chunk only stores blocks and builds its mesh on the CPU. Uploading
+// and drawing that mesh is left to the renderer (see ChunkDrawable),
+// so the world can be generated and meshed without a GL context.
+class Chunk {
+    friend class ChunkSnapshot;
 
-// TODO have Chunk inherit from Drawable
-class Chunk : public Drawable {
 private:
-    // All of the blocks contained within this Chunk
-    std::array<BlockType, 65536> m_blocks;
+    // All of the blocks contained within this Chunk, and their light
+    // levels (see Lighting), sixteen layers to a section. Sections are
+    // shared with snapshots, which copy them as they were when taken.
+    std::array<sPtr<ChunkSection>, 16> m_sections;
+    // How many of the blocks give off light, so lighting can skip
+    // searching for them in the many Chunks without any
+    int m_lightSources;
+    // The height of the highest non-EMPTY block of every column, or -1
+    // if the column is all air, indexed x + 16 * z. Kept up to date by
+    // setBlockAt, so nothing has to scan a column to find its surface.
+    std::array<int16_t, 256> m_surfaceHeights;
+    // How mountainous (1) or grassy (0) each column was generated,
+    // indexed x + 16 * z
+    std::array<float, 256> m_biomeWeights;
+    // The ground height generation chose for each column, below any
+    // water, indexed x + 16 * z
+    std::array<int16_t, 256> m_terrainHeights;
+    ChunkStage m_stage;
+    // Bit s is set once a non-EMPTY block has been put in section s,
+    // so reset only clears those
+    uint16_t m_usedSections;
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
+    // World-space x-z coordinates of this Chunk's lower-left corner
+    glm::ivec2 m_origin;
+    // Incremented whenever anything this Chunk's mesh depends on changes
+    // (its blocks or its neighbors), so renderers know to re-mesh it
+    uint64_t m_revision;
+
+    // The Chunk holding the block at Chunk-local x and z, which may be
+    // this one or one of its eight surrounding Chunks, or nullptr if that
+    // Chunk doesn't exist. Shifts x and z into the returned Chunk's space.
+    const Chunk* chunkHolding(int *x, int *z) const;
+
+    // Section s, copied first if a snapshot shares it, so it can be written
+    ChunkSection& writableSection(int s);
+    // The block at Chunk-local coordinates, without bounds checks
+    const BlockType& blockAt(unsigned int x, unsigned int y, unsigned int z) const;
+
+    // A Chunk sharing this one's sections and copying everything else,
+    // neighbors included, for ChunkSnapshot to relink
+    Chunk(const Chunk &other) = default;
 
 public:
-    Chunk(OpenGLContext* mp_context);
+    Chunk(int x, int z);
+    // Turns this back into a newly instantiated, all EMPTY Chunk with the
+    // given origin, for ChunkPool to reuse. Only the sections that ever
+    // held a block are cleared. The revision keeps counting up, so
+    // renderers keyed by Chunk see that it changed.
+    void reset(int x, int z);
+    glm::ivec2 getOrigin() const;
+    uint64_t getRevision() const;
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAt(glm::ivec3 pos) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Unlinks this Chunk and its neighbors from each other, before it is unloaded
+    void unlinkNeighbors();
+    // The adjacent Chunk in the given horizontal direction, or nullptr
+    Chunk* getNeighbor(const Direction &dir) const;
+
+    // Cheap tests of the block at Chunk-local coordinates, without
+    // copying its BlockType
+    bool isOpaqueAt(unsigned int x, unsigned int y, unsigned int z) const;
+    bool isEmptyAt(unsigned int x, unsigned int y, unsigned int z) const;
+    int getLightEmissionAt(unsigned int x, unsigned int y, unsigned int z) const;
+    bool hasLightSources() const;
+
+    // The height of the highest non-EMPTY block in the column at
+    // Chunk-local x and z, or -1 if the column is all air
+    int getSurfaceHeight(unsigned int x, unsigned int z) const;
+    // The biome weight terrain generation chose for the column at
+    // Chunk-local x and z, from 0 (grassland) to 1 (mountains)
+    float getBiomeWeight(unsigned int x, unsigned int z) const;
+    void setBiomeWeight(unsigned int x, unsigned int z, float weight);
+    // The ground height terrain generation chose for the column at
+    // Chunk-local x and z, before any blocks were placed on it
+    int getTerrainHeight(unsigned int x, unsigned int z) const;
+    void setTerrainHeight(unsigned int x, unsigned int z, int height);
+
+    ChunkStage getStage() const;
+    void setStage(ChunkStage stage);
+    // Whether this Chunk and the eight around it have all been lit. Only
+    // then do its blocks, its neighbors' blocks along its borders and the
+    // light around it stop changing as the world is generated, so meshing
+    // it any earlier would give faces that have to be rebuilt.
+    bool isReadyToMesh() const;
+    // Whether the block at pos, which may lie in a neighboring Chunk, is
+    // opaque. Blocks outside the world or in missing Chunks are not.
+    bool isOpaqueAt(glm::ivec3 pos) const;
+
+    // Light levels (0 to 15) at Chunk-local coordinates
+    uint8_t getSkyLightAt(unsigned int x, unsigned int y, unsigned int z) const;
+    uint8_t getBlockLightAt(unsigned int x, unsigned int y, unsigned int z) const;
+    void setSkyLightAt(unsigned int x, unsigned int y, unsigned int z, uint8_t level);
+    void setBlockLightAt(unsigned int x, unsigned int y, unsigned int z, uint8_t level);
+    // The packed light of a block, which may lie in a neighboring Chunk. Blocks
+    // above the world or in Chunks that don't exist yet are in full sunlight.
+    uint8_t getPackedLightAt(int x, int y, int z) const;
+
+    // A 64-bit FNV-1a hash of every block and light level, for checking
+    // that terrain generation reproduces the same Chunks
+    uint64_t contentHash() const;
+
+    // Tells renderers to re-mesh this Chunk, for changes that setBlockAt
+    // can't see, such as light spreading in from elsewhere
+    void markChanged();
+
+    // Finds which faces of every block are visible, into mesh->visibleFaces,
+    // and counts the opaque and translucent ones. Rather than looking at
+    // each block's six neighbors in turn, it builds a 256-bit mask of the
+    // opaque blocks of every column, and of each translucent type, plus
+    // those of the neighbors' border columns. Each column's visible faces
+    // in all six directions then come from shifts and ANDs of those masks,
+    // and only their set bits are visited.
+    void findVisibleFaces(ChunkMesh *mesh, size_t *opaqueFaces, size_t *translucentFaces) const;
 
-    virtual void createVBOdata();
+    // Builds this Chunk's opaque and translucent geometry, in
+    // Chunk-local coordinates, into the given mesh, replacing what it held
+    void createMeshData(ChunkMesh *mesh) const;
 };
@@ -0,0 +1,85 @@
+#include "chunkmap.h"
+#include <stdexcept>
+#include <string>
+
+ChunkMap::ChunkMap()
+    : m_slots(64), m_shift(64 - 6), m_size(0)
+{}
+
+void ChunkMap::grow() {
+    std::vector<Slot> old(m_slots.size() * 2);
+    old.swap(m_slots);
+    m_shift--;
+    size_t mask = m_slots.size() - 1;
+    for(Slot &s : old) {
+        if(s.chunk != nullptr) {
+            size_t i = slotOf(s.key);
+            while(m_slots[i].chunk != nullptr) {
+                i = (i + 1) & mask;
+            }
+            m_slots[i].key = s.key;
+            m_slots[i].chunk = std::move(s.chunk);
+        }
+    }
+}
+
+uPtr<Chunk>& ChunkMap::at(int64_t key) {
+    size_t mask = m_slots.size() - 1;
+    for(size_t i = slotOf(key); m_slots[i].chunk != nullptr; i = (i + 1) & mask) {
+        if(m_slots[i].key == key) {
+            return m_slots[i].chunk;
+        }
+    }
+    throw std::out_of_range("No Chunk has key " + std::to_string(key));
+}
+
+const uPtr<Chunk>& ChunkMap::at(int64_t key) const {
+    return const_cast<ChunkMap*>(this)->at(key);
+}
+
+Chunk* ChunkMap::insert(int64_t key, uPtr<Chunk> chunk) {
+    if(2 * (m_size + 1) > static_cast<int>(m_slots.size())) {
+        grow();
+    }
+    size_t mask = m_slots.size() - 1;
+    size_t i = slotOf(key);
+    while(m_slots[i].chunk != nullptr && m_slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    if(m_slots[i].chunk == nullptr) {
+        m_size++;
+    }
+    m_slots[i].key = key;
+    m_slots[i].chunk = std::move(chunk);
+    return m_slots[i].chunk.get();
+}
+
+uPtr<Chunk> ChunkMap::remove(int64_t key) {
+    size_t mask = m_slots.size() - 1;
+    size_t i = slotOf(key);
+    while(m_slots[i].chunk != nullptr && m_slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+    if(m_slots[i].chunk == nullptr) {
+        return nullptr;
+    }
+    uPtr<Chunk> removed = std::move(m_slots[i].chunk);
+    m_size--;
+
+    // Later Chunks of the same probe run would no longer be found past
+    // the hole, so move back each one whose home slot isn't after the hole
+    size_t hole = i;
+    for(size_t j = (i + 1) & mask; m_slots[j].chunk != nullptr; j = (j + 1) & mask) {
+        size_t home = slotOf(m_slots[j].key);
+        if(((j - home) & mask) >= ((j - hole) & mask)) {
+            m_slots[hole].key = m_slots[j].key;
+            m_slots[hole].chunk = std::move(m_slots[j].chunk);
+            hole = j;
+        }
+    }
+    return removed;
+}
+
+int ChunkMap::size() const {
+    return m_size;
+}
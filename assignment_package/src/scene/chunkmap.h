@@ -0,0 +1,75 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "chunk.h"
+#include <cstdint>
+#include <vector>
+
+// The map from Chunk origin keys (see toKey in terrain.h) to the Chunks
+// Terrain owns. Every block query goes through it, so rather than a
+// node-based std::unordered_map it is a flat, open-addressing table:
+// each slot holds a key next to its Chunk, keys are spread over the
+// table by a Fibonacci hash (one multiply and one shift), and collisions
+// probe the following slots. A lookup usually touches a single slot.
+// The table is kept at most half full, so a probe always ends at an
+// empty slot.
+class ChunkMap
+{
+private:
+    struct Slot {
+        int64_t key;
+        uPtr<Chunk> chunk; // nullptr if the slot is empty
+    };
+
+    std::vector<Slot> m_slots; // The size is always a power of two
+    int m_shift;               // 64 minus log2 of the number of slots
+    int m_size;
+
+    size_t slotOf(int64_t key) const {
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+    // Doubles the number of slots, re-filing every Chunk
+    void grow();
+
+public:
+    ChunkMap();
+
+    // The Chunk with the given key, or nullptr if there is none
+    Chunk* find(int64_t key) const {
+        size_t mask = m_slots.size() - 1;
+        for(size_t i = slotOf(key); ; i = (i + 1) & mask) {
+            const Slot &s = m_slots[i];
+            if(s.chunk == nullptr) {
+                return nullptr;
+            }
+            if(s.key == key) {
+                return s.chunk.get();
+            }
+        }
+    }
+    // The owning pointer of the Chunk with the given key.
+    // Throws std::out_of_range if there is none.
+    uPtr<Chunk>& at(int64_t key);
+    const uPtr<Chunk>& at(int64_t key) const;
+
+    // Stores the Chunk, which must not be null, under the given key,
+    // replacing any Chunk already there, and returns it. References returned by at() are only valid
+    // until the next insert.
+    Chunk* insert(int64_t key, uPtr<Chunk> chunk);
+
+    // Takes the Chunk with the given key out of the map, returning
+    // nullptr if there is none
+    uPtr<Chunk> remove(int64_t key);
+
+    int size() const;
+
+    // Calls visit(Chunk*) for every Chunk, in no particular order.
+    // visit must not insert or remove Chunks.
+    template<typename F>
+    void forEach(F visit) const {
+        for(const Slot &s : m_slots) {
+            if(s.chunk != nullptr) {
+                visit(s.chunk.get());
+            }
+        }
+    }
+};
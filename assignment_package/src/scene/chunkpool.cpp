@@ -0,0 +1,32 @@
+#include "chunkpool.h"
+
+ChunkPool::ChunkPool()
+    : m_free(), m_stats{0, 0, 0}
+{}
+
+uPtr<Chunk> ChunkPool::acquire(int x, int z) {
+    if(m_free.empty()) {
+        m_stats.allocated++;
+        return mkU<Chunk>(x, z);
+    }
+    uPtr<Chunk> chunk = std::move(m_free.back());
+    m_free.pop_back();
+    chunk->reset(x, z);
+    m_stats.reused++;
+    return chunk;
+}
+
+void ChunkPool::release(uPtr<Chunk> chunk) {
+    if(chunk != nullptr) {
+        m_free.push_back(std::move(chunk));
+        m_stats.released++;
+    }
+}
+
+int ChunkPool::freeCount() const {
+    return static_cast<int>(m_free.size());
+}
+
+const ChunkPoolStats& ChunkPool::getStats() const {
+    return m_stats;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "chunk.h"
+#include <vector>
+
+// Counts of what a ChunkPool has handed out since it was created
+struct ChunkPoolStats {
+    int allocated; // Chunks that had to be allocated because the pool was empty
+    int reused;    // Chunks handed out again after being released
+    int released;  // Chunks given back to the pool
+};
+
+// Recycles unloaded Chunks. Every Chunk holds several megabytes of blocks,
+// so rather than freeing a Chunk that leaves the loaded area and allocating
+// and zero-filling a new one for the next that enters it, Terrain hands it
+// back here and gets it out again, reset (see Chunk::reset), as a different
+// Chunk. Once the loaded area stops growing, roaming the world allocates
+// no Chunks at all.
+//
+// Released Chunks are kept until the pool is destroyed, never freed, so a
+// Chunk's address stays unique for the pool's life. That lets renderers key
+// their GL buffers by Chunk and reuse them when the Chunk is recycled.
+class ChunkPool
+{
+private:
+    std::vector<uPtr<Chunk>> m_free;
+    ChunkPoolStats m_stats;
+
+public:
+    ChunkPool();
+
+    // A Chunk with the given origin, as freshly instantiated
+    uPtr<Chunk> acquire(int x, int z);
+    // Takes back a Chunk that has been unloaded and unlinked from its neighbors
+    void release(uPtr<Chunk> chunk);
+
+    // How many released Chunks are waiting to be reused
+    int freeCount() const;
+    const ChunkPoolStats& getStats() const;
+};
@@ -0,0 +1,49 @@
+#include "chunksnapshot.h"
+#include <algorithm>
+
+ChunkSnapshot::ChunkSnapshot(const Chunk &chunk)
+    : m_chunks(), mp_source(&chunk), m_revision(chunk.getRevision())
+{
+    // The Chunk, its sides, and the corners, which meshing reaches
+    // through either side
+    std::vector<const Chunk*> sources {&chunk};
+    glm::ivec2 origin = chunk.getOrigin();
+    for (size_t i = 0; i < sources.size(); i++) {
+        for (const auto &neighbor : sources[i]->m_neighbors) {
+            const Chunk *c = neighbor.second;
+            if (c == nullptr || std::find(sources.begin(), sources.end(), c) != sources.end()) {
+                continue;
+            }
+            glm::ivec2 offset = glm::abs(c->getOrigin() - origin);
+            if (offset.x <= 16 && offset.y <= 16) {
+                sources.push_back(c);
+            }
+        }
+    }
+
+    for (const Chunk *c : sources) {
+        m_chunks.push_back(uPtr<Chunk>(new Chunk(*c)));
+    }
+    for (auto &copy : m_chunks) {
+        for (auto &neighbor : copy->m_neighbors) {
+            auto it = std::find(sources.begin(), sources.end(), neighbor.second);
+            neighbor.second = it != sources.end() ? m_chunks[it - sources.begin()].get() : nullptr;
+        }
+    }
+}
+
+const Chunk& ChunkSnapshot::getChunk() const {
+    return *m_chunks.front();
+}
+
+const Chunk* ChunkSnapshot::getSource() const {
+    return mp_source;
+}
+
+uint64_t ChunkSnapshot::getRevision() const {
+    return m_revision;
+}
+
+bool ChunkSnapshot::isCurrent() const {
+    return mp_source->getRevision() == m_revision;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "chunk.h"
+#include <vector>
+
+// A Chunk and the eight Chunks around it, frozen as they were when the
+// snapshot was taken, so the Chunk can be meshed on another thread while
+// the world goes on being edited.
+//
+// Taking one is cheap: each copied Chunk shares its ChunkSections with the
+// original rather than copying their blocks (see ChunkSection). The first
+// edit to a shared section after that copies just that section, so the
+// snapshot keeps seeing the old blocks and the edit never touches memory
+// another thread may be reading. The snapshot remembers the revision it
+// was taken at, so whoever uploads the mesh can tell whether the Chunk has
+// changed since and the mesh is already out of date.
+//
+// Sections are shared by reference counting, which isn't synchronized
+// with edits, so snapshots must be taken and destroyed on the thread that
+// edits the Chunks. Reading and meshing them is safe on any thread.
+class ChunkSnapshot
+{
+private:
+    // The copied Chunks, linked to each other in place of the originals,
+    // the snapshotted Chunk itself first
+    std::vector<uPtr<Chunk>> m_chunks;
+    const Chunk *mp_source;
+    uint64_t m_revision;
+
+public:
+    explicit ChunkSnapshot(const Chunk &chunk);
+
+    // The copy of the snapshotted Chunk
+    const Chunk& getChunk() const;
+    // The Chunk it was taken from
+    const Chunk* getSource() const;
+    // The source Chunk's revision when the snapshot was taken
+    uint64_t getRevision() const;
+    // Whether the source Chunk is unchanged since, so a mesh built from this
+    // snapshot is still right. The source must not have been freed, which
+    // Terrain's ChunkPool guarantees by never freeing Chunks.
+    bool isCurrent() const;
+};
@@ -0,0 +1,111 @@
+#include "collision.h"
+
+// Boxes closer than this are considered touching. Without this tolerance
+// a box resting against a block could, after float rounding, end up a hair
+// inside it and then no longer be stopped by it.
+static const float EPSILON = 1e-4f;
+
+AABB AABB::swept(glm::vec3 movement) const {
+    return AABB(glm::min(min, min + movement), glm::max(max, max + movement));
+}
+
+AABB AABB::translated(glm::vec3 offset) const {
+    return AABB(min + offset, max + offset);
+}
+
+void Collision::gatherSolidBlocks(const Terrain &terrain, const AABB &region, std::vector<glm::ivec3> *blocks) {
+    glm::ivec3 lo = glm::ivec3(glm::floor(region.min - EPSILON));
+    glm::ivec3 hi = glm::ivec3(glm::floor(region.max + EPSILON));
+    lo.y = glm::max(lo.y, 0);
+    hi.y = glm::min(hi.y, 255);
+
+    for(int x = lo.x; x <= hi.x; ++x) {
+        for(int z = lo.z; z <= hi.z; ++z) {
+            // One Chunk lookup per column. Unloaded blocks are treated
+            // as solid, so nothing falls out of the loaded world.
+            const Chunk *c = terrain.findChunkAt(x, z);
+            if(c == nullptr) {
+                for(int y = lo.y; y <= hi.y; ++y) {
+                    blocks->push_back(glm::ivec3(x, y, z));
+                }
+                continue;
+            }
+            glm::ivec2 origin = c->getOrigin();
+            unsigned int lx = static_cast<unsigned int>(x - origin.x);
+            unsigned int lz = static_cast<unsigned int>(z - origin.y);
+            // Everything above the column's surface is air, so most
+            // columns under an entity have only a block or two to test
+            int top = glm::min(hi.y, c->getSurfaceHeight(lx, lz));
+            for(int y = lo.y; y <= top; ++y) {
+                if(!c->isEmptyAt(lx, static_cast<unsigned int>(y), lz)) {
+                    blocks->push_back(glm::ivec3(x, y, z));
+                }
+            }
+        }
+    }
+}
+
+// Clips the box's movement along the given axis so that it stops
+// at the first block it would otherwise enter
+static float clipAxis(const AABB &box, const std::vector<glm::ivec3> &blocks, int axis, float movement) {
+    int a1 = (axis + 1) % 3;
+    int a2 = (axis + 2) % 3;
+
+    for(const glm::ivec3 &b : blocks) {
+        glm::vec3 bMin(b), bMax = bMin + glm::vec3(1.f);
+
+        // Only blocks that overlap the box on the other two axes can stop it
+        if(box.max[a1] <= bMin[a1] + EPSILON || box.min[a1] >= bMax[a1] - EPSILON ||
+           box.max[a2] <= bMin[a2] + EPSILON || box.min[a2] >= bMax[a2] - EPSILON) {
+            continue;
+        }
+
+        if(movement > 0 && box.max[axis] <= bMin[axis] + EPSILON) {
+            movement = glm::min(movement, glm::max(0.f, bMin[axis] - box.max[axis]));
+        } else if(movement < 0 && box.min[axis] >= bMax[axis] - EPSILON) {
+            movement = glm::max(movement, glm::min(0.f, bMax[axis] - box.min[axis]));
+        }
+    }
+    return movement;
+}
+
+// Sweeps one box against the solid blocks around it, gathered into blocks
+static CollisionResult sweepBox(const Terrain &terrain, const AABB &box, glm::vec3 movement,
+                                std::vector<glm::ivec3> *blocks) {
+    CollisionResult result;
+
+    blocks->clear();
+    Collision::gatherSolidBlocks(terrain, box.swept(movement), blocks);
+
+    // Y first so that walking into a wall while falling still lands on the ground
+    AABB moved = box;
+    for(int axis : {1, 0, 2}) {
+        if(movement[axis] == 0.f) {
+            continue;
+        }
+        float clipped = clipAxis(moved, *blocks, axis, movement[axis]);
+        result.blocked[axis] = clipped != movement[axis];
+        result.movement[axis] = clipped;
+
+        glm::vec3 step(0.f);
+        step[axis] = clipped;
+        moved = moved.translated(step);
+    }
+
+    result.onGround = result.blocked[1] && movement.y < 0;
+    return result;
+}
+
+CollisionResult Collision::sweep(const Terrain &terrain, const AABB &box, glm::vec3 movement) {
+    std::vector<glm::ivec3> blocks;
+    return sweepBox(terrain, box, movement, &blocks);
+}
+
+void Collision::sweep(const Terrain &terrain, const AABB *boxes, const glm::vec3 *movements,
+                      int count, CollisionResult *out) {
+    std::vector<glm::ivec3> blocks;
+    blocks.reserve(64);
+    for(int i = 0; i < count; ++i) {
+        out[i] = sweepBox(terrain, boxes[i], movements[i], &blocks);
+    }
+}
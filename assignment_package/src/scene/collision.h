@@ -0,0 +1,50 @@
+#pragma once
+#include "glm_includes.h"
+#include "terrain.h"
+#include <vector>
+
+// An axis-aligned bounding box in world space
+struct AABB {
+    glm::vec3 min, max;
+
+    AABB() : min(0.f), max(0.f)
+    {}
+    AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max)
+    {}
+
+    // The smallest box containing this box both before and after
+    // it is moved by the given amount
+    AABB swept(glm::vec3 movement) const;
+    AABB translated(glm::vec3 offset) const;
+};
+
+// The outcome of moving a box through the world
+struct CollisionResult {
+    glm::vec3 movement;  // How far the box could actually move
+    bool blocked[3];     // Whether a block stopped the box along each axis
+    bool onGround;       // The box was moving down and landed on a block
+
+    CollisionResult() : movement(0.f), blocked{false, false, false}, onGround(false)
+    {}
+};
+
+// Swept-AABB collision of boxes against the block grid.
+//
+// Rather than casting rays from sample points on the box, sweep() gathers
+// every solid block the box could touch during its movement once, then
+// clips the movement against those blocks one axis at a time (Y, then X,
+// then Z). Works for boxes of any size, so every kind of entity can use it.
+class Collision
+{
+public:
+    // Gathers the world positions of every solid (non-EMPTY or not yet
+    // loaded) block that overlaps the given region into blocks
+    static void gatherSolidBlocks(const Terrain &terrain, const AABB &region, std::vector<glm::ivec3> *blocks);
+
+    // Moves the box by movement, stopping it at the first solid block along each axis
+    static CollisionResult sweep(const Terrain &terrain, const AABB &box, glm::vec3 movement);
+    // Sweeps count boxes at once, reusing one scratch buffer
+    // for the blocks gathered around each of them
+    static void sweep(const Terrain &terrain, const AABB *boxes, const glm::vec3 *movements,
+                      int count, CollisionResult *out);
+};
@@ -166,12 +166,17 @@ void Cube::createVBOdata()
 void Cube::createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) {
     m_numInstances = offsets.size();
 
-    generateOffsetBuf();
+    // Instances may be re-uploaded every frame, so reuse the same buffers
+    if(!m_offsetGenerated) {
+        generateOffsetBuf();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, offsets.size() * sizeof(glm::vec3), offsets.data(), GL_DYNAMIC_DRAW);
 
 
-    generateCol();
+    if(!m_colGenerated) {
+        generateCol();
+    }
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_STATIC_DRAW);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), colors.data(), GL_DYNAMIC_DRAW);
 }
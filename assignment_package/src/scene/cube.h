@@ -10,7 +10,7 @@
 class Cube : public InstancedDrawable
 {
 public:
-    Cube(OpenGLContext* context) : InstancedDrawable(context){}
+    Cube(OpenGLFunctions* context) : InstancedDrawable(context){}
     virtual ~Cube(){}
     void createVBOdata() override;
     void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) override;
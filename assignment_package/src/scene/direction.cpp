@@ -1,6 +1,6 @@
 #include "direction.h"
 
-#define blockUV 0.03125f
+#define blockUV 0.0625f // One tile of the 16 x 16 tile texture atlas
 
 // Enum value DEFINITIONS
 // The initialization occurs in the scope of the class,
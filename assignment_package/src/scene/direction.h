@@ -30,7 +30,7 @@ class Direction {
     static const Direction ZPOS;
     static const Direction ZNEG;
 
-    static vector<Direction*> all;
+    static std::vector<Direction*> all;
 
   public:
     const int index;
@@ -0,0 +1,17 @@
+#pragma once
+#include "glm_includes.h"
+#include "chunk.h"
+#include <array>
+
+// How Chunk::createMeshData shades each face it emits. They live here,
+// rather than hidden in chunk.cpp, so that the benchmark's legacy mesher
+// shades its faces with the very same code and comparing the two only
+// tests what differs between them.
+
+// Three-neighbor ambient occlusion for the four vertices of the face of the
+// block at pos (in the Chunk's space) facing d, from 0 (fully occluded) to 3
+std::array<int, 4> faceAO(const Chunk *chunk, glm::ivec3 pos, const Direction *d);
+
+// The sky and block light, each from 0 to 1, that the face of the block b
+// at pos facing d is lit by
+glm::vec2 faceLight(const Chunk *chunk, glm::ivec3 pos, const Direction *d, const BlockType &b);
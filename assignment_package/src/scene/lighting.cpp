@@ -0,0 +1,333 @@
+#include "lighting.h"
+#include "terrain.h"
+#include "profiler.h"
+#include <algorithm>
+
+namespace {
+
+// One block visited by a flood fill
+struct LightNode {
+    Chunk *chunk;
+    int x, y, z; // Chunk-local
+};
+
+// A block being darkened, with the level it had
+struct DarkNode {
+    LightNode node;
+    uint8_t level;
+};
+
+// The six neighbors of a block. YNEG is first so it can be recognized by index.
+const glm::ivec3 NEIGHBORS[6] = {
+    glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+    glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0),
+    glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+};
+const int DOWN = 0;
+
+// Finds the block next to n at the given offset, crossing into a
+// neighboring Chunk if need be. Returns false if it lies outside the
+// world or in a Chunk that doesn't exist.
+bool neighborOf(const LightNode &n, int i, LightNode *out) {
+    *out = LightNode{n.chunk, n.x + NEIGHBORS[i].x, n.y + NEIGHBORS[i].y, n.z + NEIGHBORS[i].z};
+    if(out->y < 0 || out->y > 255) {
+        return false;
+    }
+    if(out->x < 0) {
+        out->chunk = n.chunk->getNeighbor(Direction::XNEG);
+        out->x += 16;
+    } else if(out->x > 15) {
+        out->chunk = n.chunk->getNeighbor(Direction::XPOS);
+        out->x -= 16;
+    } else if(out->z < 0) {
+        out->chunk = n.chunk->getNeighbor(Direction::ZNEG);
+        out->z += 16;
+    } else if(out->z > 15) {
+        out->chunk = n.chunk->getNeighbor(Direction::ZPOS);
+        out->z -= 16;
+    }
+    return out->chunk != nullptr;
+}
+
+// The state of one flood fill: which channel it spreads, the blocks left to
+// visit, and the Chunks whose light it has changed
+class LightFill {
+private:
+    bool m_sky;
+    std::vector<LightNode> m_lit;
+    std::vector<DarkNode> m_darkened;
+    std::vector<Chunk*> m_changed;
+    int m_changes;
+
+public:
+    explicit LightFill(bool sky)
+        : m_sky(sky), m_lit(), m_darkened(), m_changed(), m_changes(0)
+    {}
+
+    int getChanges() const {
+        return m_changes;
+    }
+
+    uint8_t get(const LightNode &n) const {
+        return m_sky ? n.chunk->getSkyLightAt(n.x, n.y, n.z) : n.chunk->getBlockLightAt(n.x, n.y, n.z);
+    }
+
+    void set(const LightNode &n, uint8_t level) {
+        if(m_sky) {
+            n.chunk->setSkyLightAt(n.x, n.y, n.z, level);
+        } else {
+            n.chunk->setBlockLightAt(n.x, n.y, n.z, level);
+        }
+        m_changes++;
+        changed(n);
+    }
+
+    // Records that the block has changed, so its Chunk needs re-meshing,
+    // as does any Chunk that shows the faces next to it
+    void changed(const LightNode &n) {
+        remember(n.chunk);
+        if(n.x == 0) {
+            remember(n.chunk->getNeighbor(Direction::XNEG));
+        } else if(n.x == 15) {
+            remember(n.chunk->getNeighbor(Direction::XPOS));
+        }
+        if(n.z == 0) {
+            remember(n.chunk->getNeighbor(Direction::ZNEG));
+        } else if(n.z == 15) {
+            remember(n.chunk->getNeighbor(Direction::ZPOS));
+        }
+    }
+
+    void remember(Chunk *c) {
+        // Only a handful of Chunks are ever changed at once
+        if(c != nullptr && (m_changed.empty() || m_changed.back() != c) &&
+           std::find(m_changed.begin(), m_changed.end(), c) == m_changed.end()) {
+            m_changed.push_back(c);
+        }
+    }
+
+    // Marks every Chunk whose light changed for re-meshing
+    void markChanged() {
+        for(Chunk *c : m_changed) {
+            c->markChanged();
+        }
+        m_changed.clear();
+    }
+
+    // Queues a block to spread its light to its neighbors
+    void spreadFrom(const LightNode &n) {
+        m_lit.push_back(n);
+    }
+
+    // Raises a block to the given level if it is darker, and queues it to spread
+    void light(const LightNode &n, uint8_t level) {
+        if(get(n) < level) {
+            set(n, level);
+            m_lit.push_back(n);
+        }
+    }
+
+    // Darkens a block, and queues it to darken the blocks that got their light from it
+    void darken(const LightNode &n) {
+        uint8_t level = get(n);
+        if(level > 0) {
+            set(n, 0);
+            m_darkened.push_back(DarkNode{n, level});
+        }
+    }
+
+    // Spreads light outwards from every queued block
+    void spread() {
+        // Used as a FIFO queue: breadth-first order sets every block to its
+        // final level the first time it is reached, so few are revisited
+        for(size_t next = 0; next < m_lit.size(); ++next) {
+            LightNode n = m_lit[next];
+            uint8_t level = get(n);
+            if(level <= 1) {
+                continue;
+            }
+            for(int i = 0; i < 6; ++i) {
+                LightNode nb;
+                if(!neighborOf(n, i, &nb) || nb.chunk->isOpaqueAt(nb.x, nb.y, nb.z)) {
+                    continue;
+                }
+                bool fullSky = m_sky && i == DOWN && level == Lighting::MAX_LIGHT && nb.chunk->isEmptyAt(nb.x, nb.y, nb.z);
+                uint8_t spreadLevel = fullSky ? level : level - 1;
+                if(get(nb) < spreadLevel) {
+                    set(nb, spreadLevel);
+                    m_lit.push_back(nb);
+                }
+            }
+        }
+        m_lit.clear();
+    }
+
+    // Darkens every block that was lit only through the darkened blocks.
+    // Brighter blocks found along the way are lit from some other source,
+    // so they are queued to spread their light back in.
+    void spreadDarkness() {
+        for(size_t next = 0; next < m_darkened.size(); ++next) {
+            DarkNode d = m_darkened[next];
+            for(int i = 0; i < 6; ++i) {
+                LightNode nb;
+                if(!neighborOf(d.node, i, &nb)) {
+                    continue;
+                }
+                uint8_t level = get(nb);
+                bool fullSky = m_sky && i == DOWN && d.level == Lighting::MAX_LIGHT && level == Lighting::MAX_LIGHT;
+                if(level != 0 && (level < d.level || fullSky)) {
+                    set(nb, 0);
+                    m_darkened.push_back(DarkNode{nb, level});
+                    // A light source keeps its own light
+                    int emission = m_sky ? 0 : nb.chunk->getLightEmissionAt(nb.x, nb.y, nb.z);
+                    if(emission > 0) {
+                        light(nb, static_cast<uint8_t>(emission));
+                    }
+                } else if(level >= d.level) {
+                    m_lit.push_back(nb);
+                }
+            }
+        }
+        m_darkened.clear();
+    }
+};
+
+}
+
+void Lighting::lightChunks(const std::vector<Chunk*> &chunks) {
+    PROFILE_ZONE("Lighting::lightChunks");
+    LightFill sky(true), block(false);
+    auto isNew = [&](const Chunk *c) {
+        return std::find(chunks.begin(), chunks.end(), c) != chunks.end();
+    };
+
+    for(Chunk *c : chunks) {
+        // Sunlight falls straight down each column until it meets a block
+        int tops[16][16];
+        for(int x = 0; x < 16; ++x) {
+            for(int z = 0; z < 16; ++z) {
+                tops[x][z] = c->getSurfaceHeight(x, z);
+                for(int y = tops[x][z] + 1; y < 256; ++y) {
+                    c->setSkyLightAt(x, y, z, MAX_LIGHT);
+                }
+            }
+        }
+
+        // Then spreads sideways under overhangs and into the blocks below
+        // the top of each column. Only the sunlit blocks beside a taller
+        // column, and the one above the top, can light anything.
+        for(int x = 0; x < 16; ++x) {
+            for(int z = 0; z < 16; ++z) {
+                int highest = tops[x][z] + 1;
+                for(int i = 2; i < 6; ++i) {
+                    int nx = x + NEIGHBORS[i].x, nz = z + NEIGHBORS[i].z;
+                    if(nx >= 0 && nx < 16 && nz >= 0 && nz < 16) {
+                        highest = glm::max(highest, tops[nx][nz]);
+                    } else {
+                        LightNode nb;
+                        if(neighborOf(LightNode{c, x, 0, z}, i, &nb)) {
+                            highest = glm::max(highest, nb.chunk->getSurfaceHeight(nb.x, nb.z));
+                        }
+                    }
+                }
+                for(int y = tops[x][z] + 1; y <= glm::min(highest, 255); ++y) {
+                    sky.spreadFrom(LightNode{c, x, y, z});
+                }
+            }
+        }
+
+        // Light sources shine out into their surroundings
+        if(c->hasLightSources()) {
+            for(int z = 0; z < 16; ++z) {
+                for(int y = 0; y < 256; ++y) {
+                    for(int x = 0; x < 16; ++x) {
+                        int emission = c->getLightEmissionAt(x, y, z);
+                        if(emission > 0) {
+                            block.light(LightNode{c, x, y, z}, static_cast<uint8_t>(emission));
+                        }
+                    }
+                }
+            }
+        }
+
+        // Light already in the Chunks around this one flows in across the border
+        for(int i = 2; i < 6; ++i) {
+            Chunk *neighbor = c->getNeighbor(i == 2 ? Direction::XPOS : i == 3 ? Direction::XNEG :
+                                             i == 4 ? Direction::ZPOS : Direction::ZNEG);
+            if(neighbor == nullptr || isNew(neighbor)) {
+                continue;
+            }
+            for(int along = 0; along < 16; ++along) {
+                // The border blocks of this Chunk and of its neighbor
+                int x = NEIGHBORS[i].x > 0 ? 15 : NEIGHBORS[i].x < 0 ? 0 : along;
+                int z = NEIGHBORS[i].z > 0 ? 15 : NEIGHBORS[i].z < 0 ? 0 : along;
+                int nx = NEIGHBORS[i].x != 0 ? 15 - x : x;
+                int nz = NEIGHBORS[i].z != 0 ? 15 - z : z;
+                for(int y = 0; y < 256; ++y) {
+                    if(neighbor->getSkyLightAt(nx, y, nz) > c->getSkyLightAt(x, y, z) + 1) {
+                        sky.spreadFrom(LightNode{neighbor, nx, y, nz});
+                    }
+                    if(neighbor->getBlockLightAt(nx, y, nz) > c->getBlockLightAt(x, y, z) + 1) {
+                        block.spreadFrom(LightNode{neighbor, nx, y, nz});
+                    }
+                }
+            }
+        }
+    }
+
+    sky.spread();
+    block.spread();
+    sky.markChanged();
+    block.markChanged();
+}
+
+int Lighting::updateBlock(Terrain &terrain, glm::ivec3 pos, const BlockType &oldType) {
+    PROFILE_ZONE("Lighting::updateBlock");
+    Chunk *c = terrain.findChunkAt(pos.x, pos.z);
+    if(c == nullptr || pos.y < 0 || pos.y > 255) {
+        return 0;
+    }
+    glm::ivec2 origin = c->getOrigin();
+    LightNode n{c, pos.x - origin.x, pos.y, pos.z - origin.y};
+    bool opaque = c->isOpaqueAt(n.x, n.y, n.z);
+    int emission = c->getLightEmissionAt(n.x, n.y, n.z);
+    if(opaque == oldType.isOpaque() && emission == oldType.getLightEmission() &&
+       c->isEmptyAt(n.x, n.y, n.z) == (oldType == BlockType::EMPTY)) {
+        // Nothing that light depends on has changed, but the block's faces
+        // have, including those shown by the neighboring Chunk
+        LightFill fill(true);
+        fill.changed(n);
+        fill.markChanged();
+        return 0;
+    }
+
+    int changes = 0;
+    for(bool skyChannel : {true, false}) {
+        LightFill fill(skyChannel);
+        fill.changed(n);
+
+        // Take away whatever light passed through this block...
+        fill.darken(n);
+        fill.spreadDarkness();
+
+        // ...then let the light around it back in
+        if(!opaque) {
+            for(int i = 0; i < 6; ++i) {
+                LightNode nb;
+                if(neighborOf(n, i, &nb)) {
+                    fill.spreadFrom(nb);
+                }
+            }
+            if(skyChannel && n.y == 255 && c->isEmptyAt(n.x, n.y, n.z)) {
+                fill.light(n, MAX_LIGHT);
+            }
+        }
+        if(!skyChannel && emission > 0) {
+            fill.light(n, static_cast<uint8_t>(emission));
+        }
+        fill.spread();
+        fill.markChanged();
+        changes += fill.getChanges();
+    }
+    return changes;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "glm_includes.h"
+#include "chunk.h"
+#include <vector>
+
+class Terrain;
+
+// Per-block light in the style of Minecraft. Every block stores two 4-bit
+// levels (see Chunk::getSkyLightAt and getBlockLightAt): sky light, which
+// is 15 under the open sky, and block light, which is given off by blocks
+// such as lava. Both drop by one for every block they travel through, and
+// neither enters opaque blocks. Sky light also travels straight down
+// through air without dropping, so a column open to the sky is fully lit.
+//
+// Light is spread with breadth-first flood fills that follow the neighbor
+// links between Chunks, so it crosses their borders. Freshly generated
+// Chunks are lit all at once with lightChunks(). After that, updateBlock()
+// relights only what an edit can affect: it floods darkness outwards from
+// the edited block, then fills the darkened area back in from the light
+// around its edges. Every Chunk whose light changes is marked for re-meshing.
+class Lighting
+{
+public:
+    static const int MAX_LIGHT = 15;
+
+    // Lights newly generated Chunks, whose blocks have all been set and
+    // whose neighbor links are in place. Light flows in from neighboring
+    // Chunks that were lit before, and out into them.
+    static void lightChunks(const std::vector<Chunk*> &chunks);
+
+    // Relights the world around the block at pos, which has just been
+    // changed from oldType to its current type. Returns how many light
+    // levels were changed.
+    static int updateBlock(Terrain &terrain, glm::ivec3 pos, const BlockType &oldType);
+};
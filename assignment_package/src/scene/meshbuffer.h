@@ -0,0 +1,64 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include <algorithm>
+#include <cstddef>
+
+// A growable array for building meshes into. Unlike std::vector it doesn't
+// initialize its elements and has no push_back: the mesher counts what it
+// is about to write, reserves room for all of it at once, then stores
+// straight through the pointer append returns. clear keeps the memory, so
+// a buffer that is reused for every mesh stops allocating once it has
+// grown to fit the largest.
+template<typename T>
+class MeshBuffer
+{
+private:
+    uPtr<T[]> m_data;
+    size_t m_size;
+    size_t m_capacity;
+
+public:
+    MeshBuffer()
+        : m_data(), m_size(0), m_capacity(0)
+    {}
+
+    // Makes room for at least count more elements. Returns true
+    // if that took a new allocation.
+    bool reserve(size_t count) {
+        if(m_size + count <= m_capacity) {
+            return false;
+        }
+        // Doubling keeps a buffer that creeps up in size from
+        // reallocating on every mesh
+        size_t capacity = std::max(m_size + count, 2 * m_capacity);
+        uPtr<T[]> data(new T[capacity]);
+        std::copy(m_data.get(), m_data.get() + m_size, data.get());
+        m_data = std::move(data);
+        m_capacity = capacity;
+        return true;
+    }
+
+    // Grows the buffer by count elements, which must already have been
+    // reserved, and returns the first of them for the caller to fill in
+    T* append(size_t count) {
+        T *first = m_data.get() + m_size;
+        m_size += count;
+        return first;
+    }
+
+    void clear() {
+        m_size = 0;
+    }
+
+    const T* data() const {
+        return m_data.get();
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    size_t capacity() const {
+        return m_capacity;
+    }
+};
@@ -0,0 +1,197 @@
+#include "mobsystem.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+static const float GRAVITY = 20.f;        // Blocks per second squared
+static const float TERMINAL_SPEED = 50.f; // Blocks per second
+static const float JUMP_SPEED = 7.f;      // Enough to climb one block
+static const int GRAIN_SIZE = 256;        // Mobs per range handed to a thread
+
+// Advances a xorshift32 state and returns a float in [0, 1)
+static float nextRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x >> 8) * (1.f / 16777216.f);
+}
+
+MobSystem::MobSystem(ThreadPool *threads)
+    : m_positions(), m_velocities(), m_halfExtents(), m_states(), m_stateTimers(),
+      m_headings(), m_rngStates(), m_onGround(), m_boxes(), m_movements(), m_results(),
+      m_index(), mp_threads(threads)
+{}
+
+void MobSystem::setThreadPool(ThreadPool *threads) {
+    mp_threads = threads;
+}
+
+int MobSystem::spawn(glm::vec3 position, glm::vec3 halfExtents, uint32_t seed) {
+    m_positions.push_back(position);
+    m_velocities.push_back(glm::vec3(0.f));
+    m_halfExtents.push_back(halfExtents);
+    m_states.push_back(MobState::IDLE);
+    m_stateTimers.push_back(0.f); // Picks a state on its first tick
+    m_headings.push_back(0.f);
+    // xorshift gets stuck on 0
+    m_rngStates.push_back(seed != 0 ? seed : 0x9E3779B9u);
+    m_onGround.push_back(false);
+    m_index.insert(size() - 1, getBoundingBox(size() - 1));
+    return size() - 1;
+}
+
+int MobSystem::spawnWanderers(const Terrain &terrain, glm::vec3 center, float radius, int count, uint32_t seed) {
+    uint32_t rng = seed != 0 ? seed : 1u;
+    int spawned = 0;
+    for(int i = 0; i < count; ++i) {
+        float angle = glm::radians(360.f) * nextRandom(&rng);
+        // sqrt spreads the mobs evenly over the disc
+        float distance = radius * glm::sqrt(nextRandom(&rng));
+        glm::vec3 halfExtents(0.3f + 0.2f * nextRandom(&rng), 0.45f + 0.4f * nextRandom(&rng), 0.f);
+        halfExtents.z = halfExtents.x;
+        uint32_t mobSeed = rng * 2654435761u + i;
+
+        int x = static_cast<int>(glm::floor(center.x + distance * glm::cos(angle)));
+        int z = static_cast<int>(glm::floor(center.z + distance * glm::sin(angle)));
+        if(terrain.findChunkAt(x, z) == nullptr) {
+            continue;
+        }
+        int y = glm::max(terrain.surfaceHeight(x, z), 0);
+        spawn(glm::vec3(x + 0.5f, y + 1.f, z + 0.5f), halfExtents, mobSeed);
+        spawned++;
+    }
+    return spawned;
+}
+
+void MobSystem::despawn(int index) {
+    int last = size() - 1;
+    if(index < 0 || index > last) {
+        return;
+    }
+    m_positions[index] = m_positions[last];
+    m_velocities[index] = m_velocities[last];
+    m_halfExtents[index] = m_halfExtents[last];
+    m_states[index] = m_states[last];
+    m_stateTimers[index] = m_stateTimers[last];
+    m_headings[index] = m_headings[last];
+    m_rngStates[index] = m_rngStates[last];
+    m_onGround[index] = m_onGround[last];
+
+    m_positions.pop_back();
+    m_velocities.pop_back();
+    m_halfExtents.pop_back();
+    m_states.pop_back();
+    m_stateTimers.pop_back();
+    m_headings.pop_back();
+    m_rngStates.pop_back();
+    m_onGround.pop_back();
+
+    // The last mob now goes by index
+    m_index.remove(last);
+    if(index != last) {
+        m_index.update(index, getBoundingBox(index));
+    }
+}
+
+void MobSystem::clear() {
+    m_positions.clear();
+    m_velocities.clear();
+    m_halfExtents.clear();
+    m_states.clear();
+    m_stateTimers.clear();
+    m_headings.clear();
+    m_rngStates.clear();
+    m_onGround.clear();
+    m_index.clear();
+}
+
+int MobSystem::size() const {
+    return static_cast<int>(m_positions.size());
+}
+
+const std::vector<glm::vec3>& MobSystem::getPositions() const {
+    return m_positions;
+}
+
+const std::vector<glm::vec3>& MobSystem::getHalfExtents() const {
+    return m_halfExtents;
+}
+
+AABB MobSystem::getBoundingBox(int index) const {
+    glm::vec3 p = m_positions[index], h = m_halfExtents[index];
+    return AABB(p - glm::vec3(h.x, 0.f, h.z), p + glm::vec3(h.x, 2.f * h.y, h.z));
+}
+
+bool MobSystem::isOnGround(int index) const {
+    return m_onGround[index];
+}
+
+const SpatialHash& MobSystem::getSpatialHash() const {
+    return m_index;
+}
+
+void MobSystem::updateAI(int begin, int end, float dT) {
+    for(int i = begin; i < end; ++i) {
+        m_stateTimers[i] -= dT;
+        if(m_stateTimers[i] <= 0.f) {
+            // Stand still for a while about a third of the time,
+            // otherwise walk off in a new direction
+            uint32_t *rng = &m_rngStates[i];
+            m_states[i] = nextRandom(rng) < 0.3f ? MobState::IDLE : MobState::WALKING;
+            m_headings[i] = glm::radians(360.f) * nextRandom(rng);
+            m_stateTimers[i] = 1.f + 4.f * nextRandom(rng);
+
+            float speed = m_states[i] == MobState::WALKING ? 1.5f + 1.5f * nextRandom(rng) : 0.f;
+            m_velocities[i].x = speed * glm::cos(m_headings[i]);
+            m_velocities[i].z = speed * glm::sin(m_headings[i]);
+        }
+    }
+}
+
+void MobSystem::updatePhysics(int begin, int end, float dT, const Terrain &terrain) {
+    for(int i = begin; i < end; ++i) {
+        m_velocities[i].y = glm::max(m_velocities[i].y - GRAVITY * dT, -TERMINAL_SPEED);
+        m_boxes[i] = getBoundingBox(i);
+        m_movements[i] = m_velocities[i] * dT;
+    }
+
+    Collision::sweep(terrain, &m_boxes[begin], &m_movements[begin], end - begin, &m_results[begin]);
+
+    for(int i = begin; i < end; ++i) {
+        const CollisionResult &result = m_results[i];
+        m_positions[i] += result.movement;
+        m_onGround[i] = result.onGround;
+        if(result.blocked[1]) {
+            m_velocities[i].y = 0.f;
+        }
+        // Hop up onto whatever is in the way
+        if(m_onGround[i] && (result.blocked[0] || result.blocked[2])) {
+            m_velocities[i].y = JUMP_SPEED;
+        }
+    }
+}
+
+void MobSystem::tick(float dT, const Terrain &terrain) {
+    PROFILE_ZONE("MobSystem::tick");
+    int count = size();
+    m_boxes.resize(count);
+    m_movements.resize(count);
+    m_results.resize(count);
+
+    auto update = [&](int begin, int end) {
+        updateAI(begin, end, dT);
+        updatePhysics(begin, end, dT, terrain);
+    };
+    if(mp_threads != nullptr) {
+        mp_threads->parallelFor(count, GRAIN_SIZE, update);
+    } else {
+        update(0, count);
+    }
+
+    // The hash isn't thread safe, but nearly every mob stays in its cell,
+    // so this is little more than copying the boxes
+    for(int i = 0; i < count; ++i) {
+        m_index.update(i, getBoundingBox(i));
+    }
+}
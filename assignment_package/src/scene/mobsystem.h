@@ -0,0 +1,75 @@
+#pragma once
+#include "glm_includes.h"
+#include "collision.h"
+#include "spatialhash.h"
+#include "terrain.h"
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// What a mob's simple wandering AI is currently doing
+enum class MobState : unsigned char {
+    IDLE, WALKING
+};
+
+// Stores every mob in the world as parallel arrays of components, one
+// element per mob, rather than as one object per mob. Each system (the
+// wandering AI, then physics and collision) runs over a whole array at
+// once, so tens of thousands of mobs can be ticked every frame, split
+// across the threads of a ThreadPool.
+//
+// Mobs are identified by their index, which stays valid until a mob
+// before the end of the arrays is despawned.
+class MobSystem
+{
+private:
+    // Components
+    std::vector<glm::vec3> m_positions;   // Bottom center of each mob's box
+    std::vector<glm::vec3> m_velocities;  // In blocks per second
+    std::vector<glm::vec3> m_halfExtents; // Half the size of each mob's box
+    std::vector<MobState> m_states;
+    std::vector<float> m_stateTimers;     // Seconds until the AI picks a new state
+    std::vector<float> m_headings;        // Walking direction, in radians around y
+    std::vector<uint32_t> m_rngStates;    // Per-mob xorshift state, so the AI needs no locking
+    std::vector<unsigned char> m_onGround; // Not vector<bool>, which threads can't write to separately
+
+    // Scratch space for batched collision, reused every tick
+    std::vector<AABB> m_boxes;
+    std::vector<glm::vec3> m_movements;
+    std::vector<CollisionResult> m_results;
+
+    SpatialHash m_index; // Every mob's box, keyed by its index, kept up to date by tick()
+
+    ThreadPool *mp_threads; // nullptr runs every system on the calling thread
+
+    // The systems, each run over the mobs in [begin, end)
+    void updateAI(int begin, int end, float dT);
+    void updatePhysics(int begin, int end, float dT, const Terrain &terrain);
+
+public:
+    MobSystem(ThreadPool *threads = nullptr);
+
+    void setThreadPool(ThreadPool *threads);
+
+    // Adds a mob with its bottom center at position and returns its index
+    int spawn(glm::vec3 position, glm::vec3 halfExtents, uint32_t seed);
+    // Spawns count mobs on top of the terrain at random points within
+    // radius blocks of center (on x and z). Columns that are not
+    // loaded are skipped, so fewer mobs may be spawned.
+    int spawnWanderers(const Terrain &terrain, glm::vec3 center, float radius, int count, uint32_t seed);
+    // Removes a mob by moving the last mob into its index
+    void despawn(int index);
+    void clear();
+
+    int size() const;
+    const std::vector<glm::vec3>& getPositions() const;
+    const std::vector<glm::vec3>& getHalfExtents() const;
+    AABB getBoundingBox(int index) const;
+    bool isOnGround(int index) const;
+    // For finding the mobs near a point, box or ray
+    const SpatialHash& getSpatialHash() const;
+
+    // Advances every mob by dT seconds
+    void tick(float dT, const Terrain &terrain);
+};
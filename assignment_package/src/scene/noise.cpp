@@ -2,108 +2,7 @@
 #include <vector>
 #include <iostream>
 #include <random>
-// hyrbid FBM using (1 - abs(Perlin)) as base
-float Noise::hybridMultiFractalInv(float x, float z, int seed, float H, float scale)
-{
-    // H = fractal increment : 1 = smooth, 0 = rough/noise
-    // scale = perlin noise scale factor (200-500)
-    float lacunarity = 10; // relative distance between frequencies
-    float octaves = 8; // number of frequenies used (6-10)
-    float offset = .7;
-    // basis() = perlin noise or other noise function
-    float frequency, result, signal, weight, remainder, pX, pZ;
-    std::vector<float> exp = std::vector<float>();
-    frequency = 1;
-    for (int i = 0; i < octaves; i++)
-    {
-        exp.push_back(pow(frequency, -H));
-        frequency *= lacunarity;
-    }
-    // calculate first octave
-    pX = x / scale * exp.at(0) + seed;
-    pZ = z / scale * exp.at(0) + seed;
-    result = (1 - glm::abs(perlin(pX, pZ, seed)) + offset) * exp.at(0);
-    weight = result;
-    // increase frequency
-    x *= lacunarity;
-    z *= lacunarity;
-    // spectral contruction
-    for (int i = 1; i < octaves; i++)
-    {
-        // prevent divergence
-        if (weight > 1) { weight = 1; }
-        // calculate next frequency and add to result
-        pX = x / scale * exp.at(i) + seed;
-        pZ = z / scale * exp.at(i) + seed;
-        signal = (1 - glm::abs(perlin(pX, pZ, seed)) + offset) * exp.at(i);
-        result += weight * signal;
-        // update weight and frequency for next iteration
-        weight *= signal;
-        x *= lacunarity;
-        z *= lacunarity;
-    }
-    /*
-    // deal with remainder
-    remainder = octaves - (int) octaves;
-    if (remainder != 0)
-    {
-        result += remainder * glm::abs(perlin(x/scale, z/scale, seed)) * exp.at(octaves - 1);
-    } */
-    //std::cout << result << std::endl;
-    return result;
-}
-
-// hyrbid FBM using Perlin as base
-float Noise::hybridMultiFractal(float x, float z, int seed, float H, float scale)
-{
-    // H = fractal increment : 1 = smooth, 0 = rough/noise
-    // scale = perlin noise scale factor (200-500)
-    float lacunarity = 10; // relative distance between frequencies
-    float octaves = 8; // number of frequenies used (6-10)
-    float offset = .7;
-    // basis() = perlin noise or other noise function
-    float frequency, result, signal, weight, remainder, pX, pZ;
-    std::vector<float> exp = std::vector<float>();
-    frequency = 1;
-    for (int i = 0; i < octaves; i++)
-    {
-        exp.push_back(pow(frequency, -H));
-        frequency *= lacunarity;
-    }
-    // calculate first octave
-    pX = x / scale * exp.at(0) + seed;
-    pZ = z / scale * exp.at(0) + seed;
-    result = (1 - glm::abs(perlin(pX, pZ, seed)) + offset) * exp.at(0);
-    weight = result;
-    // increase frequency
-    x *= lacunarity;
-    z *= lacunarity;
-    // spectral contruction
-    for (int i = 1; i < octaves; i++)
-    {
-        // prevent divergence
-        if (weight > 1) { weight = 1; }
-        // calculate next frequency and add to result
-        pX = x / scale * exp.at(i) + seed;
-        pZ = z / scale * exp.at(i) + seed;
-        signal = (1 - glm::abs(perlin(pX, pZ, seed)) + offset) * exp.at(i);
-        result += weight * signal;
-        // update weight and frequency for next iteration
-        weight *= signal;
-        x *= lacunarity;
-        z *= lacunarity;
-    }
-    /*
-    // deal with remainder
-    remainder = octaves - (int) octaves;
-    if (remainder != 0)
-    {
-        result += remainder * glm::abs(perlin(x/scale, z/scale, seed)) * exp.at(octaves - 1);
-    } */
-    //std::cout << result << std::endl;
-    return result;
-}
-
+#include <cstdint>
 // weighted average (quintic) falloff for perlin
 float Noise::falloff(glm::vec2 P, glm::vec2 gridP)
 {
@@ -157,12 +56,17 @@ float Noise::surflet(glm::vec2 P, glm::vec2 gridP, int seed)
 
 glm::vec2 Noise::random2(int x, int z, int seed)
 {
-    glm::vec2 p = glm::vec2(x, z);
-
-    return glm::fract(glm::sin(glm::vec2(glm::dot(p, glm::vec2(127.1f, 311.7f)),
-                      glm::dot(p, glm::vec2(269.5f, 183.3f)))) * 43758.5453f);
-
-    //return glm::vec2(random1(seed), random1(seed));
+    // Hash the seed together with the lattice point, so every seed gets its
+    // own gradient field without moving the sample position.
+    uint32_t h = static_cast<uint32_t>(seed) * 0x9e3779b9U;
+    h ^= static_cast<uint32_t>(x) * 0x85ebca6bU;
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= static_cast<uint32_t>(z) * 0xc2b2ae35U;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return glm::vec2(h & 0xffffU, h >> 16) / 65536.f;
 }
 
 glm::vec2 Noise::random2(glm::vec2 p, int seed)
@@ -170,15 +74,41 @@ glm::vec2 Noise::random2(glm::vec2 p, int seed)
     return random2(p[0], p[1], seed);
 }
 
-int Noise::irandom1()
+// Picks one of the 12 gradients pointing at the edges of a cube
+static glm::vec3 gradient3D(int x, int y, int z, int seed)
 {
-    float x;
-    //std::default_random_engine rand(reinterpret_cast<uint64_t>(&x));
-    //std::uniform_int_distribution<int> distribution(0, 214762);
-    //return distribution(rand);
-    glm::vec2 p = glm::vec2(reinterpret_cast<uint64_t>(&x), 417.27 * glm::fract(reinterpret_cast<uint64_t>(&x) / 41857.74127));
+    static const glm::vec3 gradients[12] = {
+        glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0), glm::vec3(1, -1, 0), glm::vec3(-1, -1, 0),
+        glm::vec3(1, 0, 1), glm::vec3(-1, 0, 1), glm::vec3(1, 0, -1), glm::vec3(-1, 0, -1),
+        glm::vec3(0, 1, 1), glm::vec3(0, -1, 1), glm::vec3(0, 1, -1), glm::vec3(0, -1, -1)
+    };
+    uint32_t h = static_cast<uint32_t>(seed) * 0x27d4eb2dU;
+    h ^= static_cast<uint32_t>(x) * 0x8da6b343U;
+    h ^= static_cast<uint32_t>(y) * 0xd8163841U;
+    h ^= static_cast<uint32_t>(z) * 0xcb1ab31fU;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6dU;
+    h ^= h >> 12;
+    return gradients[h % 12];
+}
 
-    return glm::fract(glm::sin(glm::dot(p, glm::vec2(127.1f, 311.7f)))) * 21462;
+float Noise::perlin3D(glm::vec3 p, int seed)
+{
+    glm::vec3 cell = glm::floor(p);
+    glm::vec3 f = p - cell;
+    // quintic fade, as in the 2D falloff
+    glm::vec3 t = f * f * f * (f * (f * 6.f - 15.f) + 10.f);
+    int x = static_cast<int>(cell.x), y = static_cast<int>(cell.y), z = static_cast<int>(cell.z);
+
+    float corners[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::ivec3 c(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+        corners[i] = glm::dot(gradient3D(x + c.x, y + c.y, z + c.z, seed), f - glm::vec3(c));
+    }
+    float x0 = glm::mix(corners[0], corners[1], t.x), x1 = glm::mix(corners[2], corners[3], t.x);
+    float x2 = glm::mix(corners[4], corners[5], t.x), x3 = glm::mix(corners[6], corners[7], t.x);
+    return glm::mix(glm::mix(x0, x1, t.y), glm::mix(x2, x3, t.y), t.z);
 }
 
 float Noise::random1(int seed)
@@ -1,12 +1,22 @@
 #pragma once
 #include "glm_includes.h"
+#include <array>
+#include <cmath>
 
+template<int Octaves, int Lacunarity> struct FBMParameters;
+
+// Every function here is a pure function of its arguments, so the same
+// seed always produces the same world. The world seed is hashed into the
+// gradients of the noise lattice rather than added to the sample position,
+// so any int seed gives the same amount of detail; nothing is read from
+// global state.
 class Noise
 {
 public:
-    // fbm noise
-    static float hybridMultiFractalInv(float x, float z, int seed, float H, float scale);
-    static float hybridMultiFractal(float x, float z, int seed, float H, float scale);
+    // fbm noise, see FBMParameters below
+    template<typename Basis, int Octaves, int Lacunarity>
+    static float hybridMultiFractal(const FBMParameters<Octaves, Lacunarity> &params,
+                                    float x, float z, int seed);
     static glm::vec2 random2(int, int, int seed);
     static glm::vec2 random2(glm::vec2, int seed);
 
@@ -16,6 +26,76 @@ public:
     static float perlin(float, float, int);
     static float surflet(glm::vec2, glm::vec2, int);
 
-    static int irandom1();
+    // 3D gradient noise, roughly within [-1, 1]. Like the 2D noise its
+    // gradients are picked by an integer hash of the lattice point and the
+    // seed, so it gives bit-identical results on every platform.
+    static float perlin3D(glm::vec3 p, int seed);
+
     static float random1(int);
 };
+
+// The parameters of one hybrid multifractal FBM. The octave count and the
+// lacunarity (the frequency ratio between octaves) are fixed at compile
+// time so the octave loop unrolls; the weight of each octave,
+// frequency^-H, is worked out once here rather than on every sample.
+// Build one per height map and keep it for the life of the program.
+template<int Octaves = 8, int Lacunarity = 10>
+struct FBMParameters {
+    float scale;  // Blocks per unit of the basis noise (200-500)
+    float offset; // Added to the basis so the weights stay positive
+    std::array<float, Octaves> weights;
+
+    // H is the fractal increment: 1 is smooth, 0 is rough
+    FBMParameters(float H, float scale, float offset = .7f)
+        : scale(scale), offset(offset), weights()
+    {
+        float frequency = 1;
+        for (int i = 0; i < Octaves; i++)
+        {
+            weights[i] = pow(frequency, -H);
+            frequency *= Lacunarity;
+        }
+    }
+};
+
+// Basis functions for Noise::hybridMultiFractal
+
+// Ridges along the zero crossings of Perlin noise, (1 - abs(Perlin))
+struct RidgedPerlin {
+    float operator()(float x, float z, int seed) const {
+        return 1 - glm::abs(Noise::perlin(x, z, seed));
+    }
+};
+
+// hybrid FBM over the given basis: each octave is weighted by the
+// octaves before it, so rough detail only builds up on high ground
+template<typename Basis, int Octaves, int Lacunarity>
+float Noise::hybridMultiFractal(const FBMParameters<Octaves, Lacunarity> &params, float x, float z, int seed)
+{
+    static_assert(Octaves > 0, "an FBM needs at least one octave");
+    Basis basis;
+    // calculate first octave
+    float pX = x / params.scale * params.weights[0];
+    float pZ = z / params.scale * params.weights[0];
+    float result = (basis(pX, pZ, seed) + params.offset) * params.weights[0];
+    float weight = result;
+    // increase frequency
+    x *= Lacunarity;
+    z *= Lacunarity;
+    // spectral construction
+    for (int i = 1; i < Octaves; i++)
+    {
+        // prevent divergence
+        if (weight > 1) { weight = 1; }
+        // calculate next frequency and add to result
+        pX = x / params.scale * params.weights[i];
+        pZ = z / params.scale * params.weights[i];
+        float signal = (basis(pX, pZ, seed) + params.offset) * params.weights[i];
+        result += weight * signal;
+        // update weight and frequency for next iteration
+        weight *= signal;
+        x *= Lacunarity;
+        z *= Lacunarity;
+    }
+    return result;
+}
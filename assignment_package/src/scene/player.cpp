@@ -1,12 +1,14 @@
 #include "player.h"
 #include <QString>
 #include <iostream>
+#include "profiler.h"
 
 using namespace std;
 
 Player::Player(glm::vec3 pos, Terrain &terrain)
     : Entity(pos), m_velocity(0,0,0), m_acceleration(0,0,0),
       m_camera(pos + glm::vec3(0, 1.5f, 0)), mcr_terrain(terrain),
+      mp_entities(nullptr), m_hitEntity(-1), m_placedBlock(BlockType::STONE),
       mcr_camera(m_camera),
       flight_mode(true),
       on_ground(false),
@@ -50,7 +52,7 @@ void Player::processInputs(InputBundle &inputs) {
     }
 
     if (inputs.rightclickPressed) {
-        addBlock(BlockType::STONE);
+        addBlock(m_placedBlock);
         inputs.rightclickPressed = false;
     }
 
@@ -101,157 +103,65 @@ void Player::computePhysics(float dT, const Terrain &terrain) {
     moveAlongVector(move_ray);
 }
 
-// Casts rays from each corner of the player's 1x2 cube
-// We cast rays for each cardinal axis
+// Sweeps the player's collision box along the movement ray and
+// clips the ray wherever the box would enter a block
 void Player::detectCollisions(vec3 *ray_dir, const Terrain &terrain) {
-    float out_dist = 0;
-    ivec3 out_blockHit = ivec3();
-    float axis;
-    vec3 start = m_position - vec3(0.5,0,0.5);
+    PROFILE_ZONE("Player::detectCollisions");
+    CollisionResult result = Collision::sweep(terrain, getBoundingBox(), *ray_dir);
 
-    float min_outdist_x = INT_MAX;
-    float min_outdist_y = INT_MAX;
-    float min_outdist_z = INT_MAX;
+    // Check if we are currently standing on something, in which case we can jump
+    on_ground = result.onGround;
 
-    vec3 ray_dir_x = vec3(ray_dir->x, 0, 0);
-    vec3 ray_dir_y = vec3(0, ray_dir->y, 0);
-    vec3 ray_dir_z = vec3(0, 0,ray_dir->z);
-
-    //Make collision box slightly smaller than 1x2 cube so we fit inside 1x1 holes
-    float offset = 0.1;
-    for (float x = 0 + offset; x <= 1; x += (1 - 2*offset)) {
-        for (float z = 0 + offset; z <= 1; z += (1 - 2*offset)) {
-            for (float y = 0 + offset; y <= 2.f - offset; y += (1 - offset)) {
-                vec3 ray_origin = start + vec3(x,y,z);
-
-                // Get the minimum distance for each cardinal axis
-                if (gridMarch(ray_origin, ray_dir_x, terrain, &out_dist, &out_blockHit, &axis)) {
-                    if (out_dist < min_outdist_x) {
-                        min_outdist_x = out_dist;
-                    }
-                }
-
-                if (gridMarch(ray_origin, ray_dir_y, terrain, &out_dist, &out_blockHit, &axis)) {
-                    if (out_dist < min_outdist_y) {
-                        min_outdist_y = out_dist;
-                    }
-                }
-
-                if (gridMarch(ray_origin, ray_dir_z, terrain, &out_dist, &out_blockHit, &axis)) {
-                    if (out_dist < min_outdist_z) {
-                        min_outdist_z = out_dist;
-                    }
-                }
-            }
-        }
-    }
-
-    if (min_outdist_x != INT_MAX) {
-        ray_dir_x *= min_outdist_x;
-    }
-
-    if (min_outdist_y < INT_MAX) {
-        ray_dir_y *= min_outdist_y;
-
-        // Check if we are currently standing on something, in which case we can jump
-        if (abs(ray_dir_y.y) < 0.00005f) {
-            if (sign(ray_dir_y.y) == -1) {
-                on_ground = true;
-            } else {
-                on_ground = false;
-            }
-            ray_dir_y.y = 0;
+    // Stop moving into whatever we hit
+    for (int i = 0; i < 3; i++) {
+        if (result.blocked[i]) {
+            m_velocity[i] = 0;
         }
-    } else {
-        on_ground = false;
     }
 
-    if (min_outdist_z != INT_MAX) {
-        ray_dir_z *= min_outdist_z;
-    }
+    *ray_dir = result.movement;
+}
 
-    *ray_dir = (ray_dir_x + ray_dir_y + ray_dir_z);
+AABB Player::getBoundingBox() const {
+    //Make collision box slightly smaller than 1x2 cube so we fit inside 1x1 holes
+    return AABB(m_position - vec3(HALF_WIDTH, 0, HALF_WIDTH),
+                m_position + vec3(HALF_WIDTH, HEIGHT, HALF_WIDTH));
 }
 
-// Removes a block wherever the player is looking
+// Hits the entity or removes the block wherever the player is looking,
+// whichever is closer
 void Player::removeBlock() {
-    vec3 ray_origin = m_camera.mcr_position;
-    vec3 ray_dir = normalize(m_forward) * 3.f; // Multiply by 3f to set the range
-    float out_dist = 0;
-    ivec3 out_blockHit = ivec3();
-    float axis;
-
-    if (gridMarch(ray_origin, ray_dir, mcr_terrain, &out_dist, &out_blockHit, &axis)) {
-        mcr_terrain.setBlockAt(out_blockHit.x, out_blockHit.y, out_blockHit.z, BlockType::EMPTY);
-        mcr_terrain.getChunkAt(out_blockHit.x, out_blockHit.z)->createVBOdata();
+    RayHit hit = mcr_terrain.raycast(m_camera.mcr_position, m_forward, REACH);
+
+    // Only entities in front of the block can be hit
+    int entity = mp_entities != nullptr ? mp_entities->raycast(m_camera.mcr_position, m_forward, hit.distance) : -1;
+    if (entity != -1) {
+        m_hitEntity = entity;
+    } else if (hit.hit) {
+        mcr_terrain.editBlockAt(hit.block.x, hit.block.y, hit.block.z, BlockType::EMPTY);
     }
 }
 
-// Adds a stone block to where the player is looking
+// Adds a block to where the player is looking
 void Player::addBlock(const BlockType BLOCK_TYPE) {
-    vec3 ray_origin = m_camera.mcr_position;
-    vec3 ray_dir = normalize(m_forward) * 3.f; // Multiplyby 3f to set the range
-    float out_dist = 0;
-    ivec3 out_blockHit = ivec3();
-    float axis;
-
-    if (gridMarch(ray_origin, ray_dir, mcr_terrain, &out_dist, &out_blockHit, &axis)) {
-        vec3 new_blockpos = vec3(out_blockHit.x - (axis == 0 ? sign(ray_dir.x) : 0),
-                                 out_blockHit.y - (axis == 1 ? sign(ray_dir.y) : 0),
-                                 out_blockHit.z - (axis == 2 ? sign(ray_dir.z) : 0));
-        mcr_terrain.setBlockAt(new_blockpos.x, new_blockpos.y, new_blockpos.z, BLOCK_TYPE);
-        mcr_terrain.getChunkAt(new_blockpos.x, new_blockpos.z)->createVBOdata();
+    RayHit hit = mcr_terrain.raycast(m_camera.mcr_position, m_forward, REACH);
+
+    if (hit.hit) {
+        // Place the new block against the face we're looking at.
+        // It may lie past the edge of the loaded world.
+        ivec3 new_blockpos = hit.block + hit.normal;
+        mcr_terrain.editBlockAt(new_blockpos.x, new_blockpos.y, new_blockpos.z, BLOCK_TYPE);
     }
 }
 
-// Given in lecture
-bool Player::gridMarch(vec3 rayOrigin, vec3 rayDirection, const Terrain &terrain, float *out_dist, ivec3 *out_blockHit, float *axis) {
-    float maxLen = length(rayDirection); // Farthest we search
-    ivec3 currCell = ivec3(floor(rayOrigin));
-    rayDirection = normalize(rayDirection); // Now all t values represent world dist.
-
-    float curr_t = 0.f;
-    while(curr_t < maxLen) {
-        float min_t = glm::sqrt(3.f);
-        float interfaceAxis = -1; // Track axis for which t is smallest
-        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
-            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
-                float offset = glm::max(0.f, glm::sign(rayDirection[i])); // See slide 5
-                // If the player is *exactly* on an interface then
-                // they'll never move if they're looking in a negative direction
-                if(currCell[i] == rayOrigin[i] && offset == 0.f) {
-                    offset = -1.f;
-                }
-                int nextIntercept = currCell[i] + offset;
-                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
-                axis_t = glm::min(axis_t, maxLen); // Clamp to max len to avoid super out of bounds errors
-                if(axis_t < min_t) {
-                    min_t = axis_t;
-                    interfaceAxis = i;
-                }
-            }
-        }
-        if(interfaceAxis == -1) {
-            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
-        }
-        curr_t += min_t; // min_t is declared in slide 7 algorithm
-        rayOrigin += rayDirection * min_t;
-        ivec3 offset = ivec3(0,0,0);
-        // Sets it to 0 if sign is +, -1 if sign is -
-        offset[interfaceAxis] = glm::min(0.f, glm::sign(rayDirection[interfaceAxis]));
-        currCell = ivec3(glm::floor(rayOrigin)) + offset;
-        // If currCell contains something other than EMPTY, return
-        // curr_t
-        BlockType cellType = terrain.getBlockAt(currCell.x, currCell.y, currCell.z);
-        if(cellType != BlockType::EMPTY) {
-            *out_blockHit = currCell;
-            *out_dist = glm::min(maxLen, curr_t);
-            *axis = interfaceAxis;
-            return true;
-        }
-    }
-    *out_dist = glm::min(maxLen, curr_t);
-    return false;
+void Player::setEntities(const SpatialHash *entities) {
+    mp_entities = entities;
+}
+
+int Player::takeHitEntity() {
+    int entity = m_hitEntity;
+    m_hitEntity = -1;
+    return entity;
 }
 
 // Turns fligthmode on/off
@@ -260,6 +170,10 @@ void Player::toggleFlightMode() {
     flight_mode = !flight_mode;
 }
 
+void Player::togglePlacedBlock() {
+    m_placedBlock = m_placedBlock == BlockType::STONE ? BlockType::LAVA : BlockType::STONE;
+}
+
 void Player::setCameraWidthHeight(unsigned int w, unsigned int h) {
     m_camera.setWidthHeight(w, h);
 }
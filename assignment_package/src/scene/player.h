@@ -2,6 +2,9 @@
 #include "entity.h"
 #include "camera.h"
 #include "terrain.h"
+#include "collision.h"
+#include "spatialhash.h"
+#include <QString>
 
 using namespace glm;
 
@@ -10,6 +13,9 @@ private:
     glm::vec3 m_velocity, m_acceleration;
     Camera m_camera;
     Terrain &mcr_terrain;
+    const SpatialHash *mp_entities; // Entities the player can hit, may be nullptr
+    int m_hitEntity; // The entity hit since the last call to takeHitEntity(), or -1
+    BlockType m_placedBlock; // Placed by right clicking
 
     void processInputs(InputBundle &inputs);
     void computePhysics(float dT, const Terrain &terrain);
@@ -24,8 +30,6 @@ private:
 
     void detectCollisions(vec3 *ray_direction, const Terrain &terrain);
 
-    bool gridMarch(vec3 rayOrigin, vec3 rayDirection, const Terrain &terrain, float *out_dist, ivec3 *out_blockHit, float *axis);
-
     void removeBlock();
 
     void addBlock(const BlockType type);
@@ -36,11 +40,24 @@ public:
     // for easy access from MyGL
     const Camera& mcr_camera;
 
+    // Size of the player's collision box, whose bottom center is the player's position
+    static constexpr float HALF_WIDTH = 0.4f;
+    static constexpr float HEIGHT = 1.9f;
+    // How far away the player can add and remove blocks
+    static constexpr float REACH = 3.f;
+
     Player(glm::vec3 pos, Terrain &terrain);
     virtual ~Player() override;
 
     void setCameraWidthHeight(unsigned int w, unsigned int h);
 
+    AABB getBoundingBox() const;
+
+    void setEntities(const SpatialHash *entities);
+    // Returns the id of the entity the player last clicked on, if any,
+    // and forgets it. Returns -1 if no entity has been hit.
+    int takeHitEntity();
+
     void tick(float dT, InputBundle &input) override;
 
     // Player overrides all of Entity's movement
@@ -68,5 +85,7 @@ public:
     QString lookAsQString() const;
 
     void toggleFlightMode();
+    // Switches the block placed by right clicking between stone and lava
+    void togglePlacedBlock();
 
 };
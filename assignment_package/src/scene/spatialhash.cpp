@@ -0,0 +1,195 @@
+#include "spatialhash.h"
+#include "terrain.h"
+#include <cfloat>
+
+static bool overlaps(const AABB &a, const AABB &b) {
+    return a.min.x < b.max.x && b.min.x < a.max.x &&
+           a.min.y < b.max.y && b.min.y < a.max.y &&
+           a.min.z < b.max.z && b.min.z < a.max.z;
+}
+
+SpatialHash::SpatialHash(float cellSize)
+    : m_cellSize(cellSize), m_entries(), m_cells(), m_maxHalfExtent(0.f), m_size(0)
+{}
+
+float SpatialHash::getCellSize() const {
+    return m_cellSize;
+}
+
+int SpatialHash::size() const {
+    return m_size;
+}
+
+bool SpatialHash::contains(int id) const {
+    return id >= 0 && id < static_cast<int>(m_entries.size()) && m_entries[id].slot != -1;
+}
+
+glm::ivec2 SpatialHash::cellCoords(float x, float z) const {
+    return glm::ivec2(glm::floor(x / m_cellSize), glm::floor(z / m_cellSize));
+}
+
+int64_t SpatialHash::cellOf(const AABB &box) const {
+    glm::vec3 center = 0.5f * (box.min + box.max);
+    glm::ivec2 c = cellCoords(center.x, center.z);
+    return toKey(c.x, c.y);
+}
+
+void SpatialHash::addToCell(int id, int64_t cell) {
+    std::vector<int> &ids = m_cells[cell];
+    m_entries[id].cell = cell;
+    m_entries[id].slot = static_cast<int>(ids.size());
+    ids.push_back(id);
+}
+
+void SpatialHash::removeFromCell(int id) {
+    Entry &e = m_entries[id];
+    auto it = m_cells.find(e.cell);
+    std::vector<int> &ids = it->second;
+
+    // Swap the last entity of the cell into this one's slot
+    int last = ids.back();
+    ids[e.slot] = last;
+    m_entries[last].slot = e.slot;
+    ids.pop_back();
+    if(ids.empty()) {
+        m_cells.erase(it);
+    }
+    e.slot = -1;
+}
+
+void SpatialHash::insert(int id, const AABB &box) {
+    if(id < 0) {
+        return;
+    }
+    if(id >= static_cast<int>(m_entries.size())) {
+        m_entries.resize(id + 1, Entry{AABB(), 0, -1});
+    }
+    if(m_entries[id].slot != -1) {
+        update(id, box);
+        return;
+    }
+
+    m_entries[id].box = box;
+    m_maxHalfExtent = glm::max(m_maxHalfExtent, 0.5f * glm::vec2(box.max.x - box.min.x, box.max.z - box.min.z));
+    addToCell(id, cellOf(box));
+    m_size++;
+}
+
+void SpatialHash::update(int id, const AABB &box) {
+    if(!contains(id)) {
+        insert(id, box);
+        return;
+    }
+
+    Entry &e = m_entries[id];
+    e.box = box;
+    m_maxHalfExtent = glm::max(m_maxHalfExtent, 0.5f * glm::vec2(box.max.x - box.min.x, box.max.z - box.min.z));
+    int64_t cell = cellOf(box);
+    // Most moves stay within one cell
+    if(cell != e.cell) {
+        removeFromCell(id);
+        addToCell(id, cell);
+    }
+}
+
+void SpatialHash::remove(int id) {
+    if(contains(id)) {
+        removeFromCell(id);
+        m_size--;
+    }
+}
+
+void SpatialHash::clear() {
+    m_entries.clear();
+    m_cells.clear();
+    m_maxHalfExtent = glm::vec2(0.f);
+    m_size = 0;
+}
+
+template<typename F>
+void SpatialHash::forEachCandidate(const AABB &region, F visit) const {
+    // Any box overlapping region has its center within this range
+    glm::ivec2 lo = cellCoords(region.min.x - m_maxHalfExtent.x, region.min.z - m_maxHalfExtent.y);
+    glm::ivec2 hi = cellCoords(region.max.x + m_maxHalfExtent.x, region.max.z + m_maxHalfExtent.y);
+
+    for(int x = lo.x; x <= hi.x; ++x) {
+        for(int z = lo.y; z <= hi.y; ++z) {
+            auto it = m_cells.find(toKey(x, z));
+            if(it == m_cells.end()) {
+                continue;
+            }
+            for(int id : it->second) {
+                visit(id);
+            }
+        }
+    }
+}
+
+void SpatialHash::queryAABB(const AABB &box, std::vector<int> *out) const {
+    forEachCandidate(box, [&](int id) {
+        if(overlaps(m_entries[id].box, box)) {
+            out->push_back(id);
+        }
+    });
+}
+
+void SpatialHash::queryRadius(glm::vec3 center, float radius, std::vector<int> *out) const {
+    float radius2 = radius * radius;
+    forEachCandidate(AABB(center - radius, center + radius), [&](int id) {
+        const AABB &b = m_entries[id].box;
+        glm::vec3 closest = glm::clamp(center, b.min, b.max);
+        glm::vec3 d = closest - center;
+        if(glm::dot(d, d) <= radius2) {
+            out->push_back(id);
+        }
+    });
+}
+
+void SpatialHash::queryPairs(std::vector<std::pair<int, int>> *out) const {
+    for(const auto &cell : m_cells) {
+        for(int a : cell.second) {
+            const AABB &box = m_entries[a].box;
+            // Each pair is found from both sides; keep it once
+            forEachCandidate(box, [&](int b) {
+                if(a < b && overlaps(box, m_entries[b].box)) {
+                    out->push_back(std::make_pair(a, b));
+                }
+            });
+        }
+    }
+}
+
+int SpatialHash::raycast(glm::vec3 origin, glm::vec3 dir, float maxDist, float *distance) const {
+    glm::vec3 end = origin + dir * maxDist;
+    AABB region(glm::min(origin, end), glm::max(origin, end));
+
+    int closestId = -1;
+    float closest = maxDist;
+    forEachCandidate(region, [&](int id) {
+        // Slab test: the ray is inside the box between the
+        // last entry and the first exit over all three axes
+        const AABB &b = m_entries[id].box;
+        float tEnter = 0.f, tExit = closest;
+        for(int i = 0; i < 3; ++i) {
+            if(dir[i] == 0.f) {
+                if(origin[i] < b.min[i] || origin[i] > b.max[i]) {
+                    return;
+                }
+                continue;
+            }
+            float t0 = (b.min[i] - origin[i]) / dir[i];
+            float t1 = (b.max[i] - origin[i]) / dir[i];
+            tEnter = glm::max(tEnter, glm::min(t0, t1));
+            tExit = glm::min(tExit, glm::max(t0, t1));
+        }
+        if(tEnter <= tExit && (closestId == -1 || tEnter < closest)) {
+            closest = tEnter;
+            closestId = id;
+        }
+    });
+
+    if(distance != nullptr) {
+        *distance = closestId != -1 ? closest : maxDist;
+    }
+    return closestId;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "glm_includes.h"
+#include "collision.h"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A uniform grid over the x-z plane for finding entities near a point,
+// a box or a ray without testing every entity.
+//
+// Each entity is filed under the cell containing the center of its box,
+// so moving it within a cell only updates its box and moving it to another
+// cell costs two small vector edits. Queries widen their search by the
+// largest half extent ever inserted, so boxes that straddle a cell border
+// are still found. Entities are identified by small non-negative ids,
+// such as their index in MobSystem.
+class SpatialHash
+{
+private:
+    // Where one entity is filed
+    struct Entry {
+        AABB box;
+        int64_t cell; // Key of the cell holding it
+        int slot;     // Its index in that cell's vector, or -1 if not inserted
+    };
+
+    float m_cellSize;
+    std::vector<Entry> m_entries; // Indexed by id
+    std::unordered_map<int64_t, std::vector<int>> m_cells;
+    glm::vec2 m_maxHalfExtent; // Largest half extents on x and z of any box inserted
+    int m_size;
+
+    glm::ivec2 cellCoords(float x, float z) const;
+    int64_t cellOf(const AABB &box) const;
+    void addToCell(int id, int64_t cell);
+    void removeFromCell(int id);
+    // Calls visit(id) for every entity filed in a cell its box could overlap region from
+    template<typename F> void forEachCandidate(const AABB &region, F visit) const;
+
+public:
+    // cellSize is in blocks. About twice the size of a typical entity works well.
+    explicit SpatialHash(float cellSize = 4.f);
+
+    float getCellSize() const;
+    int size() const;
+    bool contains(int id) const;
+
+    // Adds an entity, or moves it if it's already present
+    void insert(int id, const AABB &box);
+    // Moves an entity to its new box. Inserts it if it's not present yet.
+    void update(int id, const AABB &box);
+    void remove(int id);
+    void clear();
+
+    // Appends the ids of every entity whose box overlaps box
+    void queryAABB(const AABB &box, std::vector<int> *out) const;
+    // Appends the ids of every entity whose box lies at least
+    // partly within radius blocks of center
+    void queryRadius(glm::vec3 center, float radius, std::vector<int> *out) const;
+    // Appends every pair of entities whose boxes overlap, smaller id first
+    void queryPairs(std::vector<std::pair<int, int>> *out) const;
+    // Returns the id of the first entity whose box the ray (from origin along
+    // the normalized dir) enters within maxDist, or -1 if there is none
+    int raycast(glm::vec3 origin, glm::vec3 dir, float maxDist, float *distance = nullptr) const;
+};
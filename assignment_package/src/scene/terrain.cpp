@@ -1,33 +1,39 @@
 #include "terrain.h"
-#include "cube.h"
 #include "noise.h"
+#include "lighting.h"
+#include "profiler.h"
+#include "threadpool.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <limits>
 
-Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), m_seed(Noise::irandom1()), mp_context(context)
+Terrain::Terrain(int seed)
+    : m_chunks(), m_chunkPool(), m_generatedTerrain(), m_seed(seed),
+      m_biomeStep(8), m_biomeMaxError(0.01f), m_caves(true),
+      m_pendingBlocks(), m_featureSources(), m_featureBlocks(), m_featureEdits(), m_requestedChunks(), mp_threads(nullptr)
 {}
 
-Terrain::~Terrain() {
-    //TODO should we be destroying VBO data for each chunk
-}
+Terrain::~Terrain()
+{}
 
 // Combine two 32-bit ints into one 64-bit int
 // where the upper 32 bits are X and the lower 32 bits are Z
 int64_t toKey(int x, int z) {
-    int64_t xz = 0xffffffffffffffff;
-    int64_t x64 = x;
-    int64_t z64 = z;
-
-    // Set all lower 32 bits to 1 so we can & with Z later
-    xz = (xz & (x64 << 32)) | 0x00000000ffffffff;
+    return static_cast<int64_t>((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) |
+                                static_cast<uint32_t>(z));
+}
 
-    // Set all upper 32 bits to 1 so we can & with XZ
-    z64 = z64 | 0xffffffff00000000;
+// The lower-left corner of the Chunk holding the given x or z. Clearing
+// the low four bits rounds down to a multiple of 16, negative numbers
+// included (-1 goes to -16, where a division would truncate it to 0).
+static int chunkCorner(int v) {
+    return v & ~15;
+}
 
-    // Combine
-    xz = xz & z64;
-    return xz;
+// The same for the terrain generation zone holding the given x or z
+static int chunkCorner64(int v) {
+    return v & ~63;
 }
 
 glm::ivec2 toCoords(int64_t k) {
@@ -48,47 +54,45 @@ glm::ivec2 toCoords(int64_t k) {
 // the coordinates at x, y, z have a corresponding Chunk
 BlockType Terrain::getBlockAt(int x, int y, int z) const
 {
-    if(hasChunkAt(x, z)) {
-        // Just disallow action below or above min/max height,
-        // but don't crash the game over it.
-        if(y < 0 || y >= 256) {
-            return BlockType::EMPTY;
-        }
-        const uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
-                             static_cast<unsigned int>(y),
-                             static_cast<unsigned int>(z - chunkOrigin.y));
-    }
-    else {
+    BlockType t;
+    if(!tryGetBlockAt(x, y, z, &t)) {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
                                 " " + std::to_string(y) + " " +
                                 std::to_string(z) + " have no Chunk!");
     }
+    return t;
 }
 
 BlockType Terrain::getBlockAt(glm::vec3 p) const {
     return getBlockAt(p.x, p.y, p.z);
 }
 
+bool Terrain::tryGetBlockAt(int x, int y, int z, BlockType *out) const
+{
+    const Chunk *c = findChunkAt(x, z);
+    if(c == nullptr) {
+        return false;
+    }
+    // Just disallow action below or above min/max height,
+    // but don't crash the game over it.
+    if(y < 0 || y >= 256) {
+        *out = BlockType::EMPTY;
+        return true;
+    }
+    glm::ivec2 chunkOrigin = c->getOrigin();
+    *out = c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
+                         static_cast<unsigned int>(y),
+                         static_cast<unsigned int>(z - chunkOrigin.y));
+    return true;
+}
+
 bool Terrain::hasChunkAt(int x, int z) const {
-    // Map x and z to their nearest Chunk corner
-    // By flooring x and z, then multiplying by 16,
-    // we clamp (x, z) to its nearest Chunk-space corner,
-    // then scale back to a world-space location.
-    // Note that floor() lets us handle negative numbers
-    // correctly, as floor(-1 / 16.f) gives us -1, as
-    // opposed to (int)(-1 / 16.f) giving us 0 (incorrect!).
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor)) != m_chunks.end();
+    return m_chunks.find(toKey(chunkCorner(x), chunkCorner(z))) != nullptr;
 }
 
 
 uPtr<Chunk>& Terrain::getChunkAt(int x, int z) {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks[toKey(16 * xFloor, 16 * zFloor)];
+    return m_chunks.at(toKey(chunkCorner(x), chunkCorner(z)));
 }
 
 ivec2 Terrain::getTerrainCornerAt(int x, int z) {
@@ -100,70 +104,277 @@ ivec2 Terrain::getTerrainCornerAt(int x, int z) {
 
 
 const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-    return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
+    return m_chunks.at(toKey(chunkCorner(x), chunkCorner(z)));
+}
+
+Chunk* Terrain::findChunkAt(int x, int z) {
+    return m_chunks.find(toKey(chunkCorner(x), chunkCorner(z)));
+}
+
+const Chunk* Terrain::findChunkAt(int x, int z) const {
+    return const_cast<Terrain*>(this)->findChunkAt(x, z);
 }
 
 void Terrain::setBlockAt(int x, int y, int z, BlockType t)
 {
-    if(hasChunkAt(x, z)) {
-        uPtr<Chunk> &c = getChunkAt(x, z);
-        glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
-        c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
-                      static_cast<unsigned int>(y),
-                      static_cast<unsigned int>(z - chunkOrigin.y),
-                      t);
-    }
-    else {
+    if(!trySetBlockAt(x, y, z, t)) {
         throw std::out_of_range("Coordinates " + std::to_string(x) +
                                 " " + std::to_string(y) + " " +
                                 std::to_string(z) + " have no Chunk!");
     }
 }
 
+bool Terrain::trySetBlockAt(int x, int y, int z, BlockType t)
+{
+    Chunk *c = findChunkAt(x, z);
+    if(c == nullptr || y < 0 || y >= 256) {
+        return false;
+    }
+    glm::ivec2 chunkOrigin = c->getOrigin();
+    c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
+                  static_cast<unsigned int>(y),
+                  static_cast<unsigned int>(z - chunkOrigin.y),
+                  t);
+    return true;
+}
+
+bool Terrain::editBlockAt(int x, int y, int z, BlockType t)
+{
+    BlockType old;
+    if(!tryGetBlockAt(x, y, z, &old) || !trySetBlockAt(x, y, z, t)) {
+        return false;
+    }
+    Lighting::updateBlock(*this, glm::ivec3(x, y, z), old);
+    return true;
+}
+
+int Terrain::surfaceHeight(int x, int z) const
+{
+    const Chunk *c = findChunkAt(x, z);
+    if(c == nullptr) {
+        return -1;
+    }
+    glm::ivec2 chunkOrigin = c->getOrigin();
+    return c->getSurfaceHeight(static_cast<unsigned int>(x - chunkOrigin.x),
+                               static_cast<unsigned int>(z - chunkOrigin.y));
+}
+
+float Terrain::biomeWeight(int x, int z) const
+{
+    const Chunk *c = findChunkAt(x, z);
+    if(c == nullptr) {
+        return -1.f;
+    }
+    glm::ivec2 chunkOrigin = c->getOrigin();
+    return c->getBiomeWeight(static_cast<unsigned int>(x - chunkOrigin.x),
+                             static_cast<unsigned int>(z - chunkOrigin.y));
+}
+
 Chunk* Terrain::instantiateChunkAt(int x, int z) {
-    uPtr<Chunk> chunk = mkU<Chunk>(mp_context);
-    Chunk *cPtr = chunk.get();
-    m_chunks[toKey(x, z)] = move(chunk);
+    Chunk *cPtr = m_chunks.insert(toKey(x, z), m_chunkPool.acquire(x, z));
     // Set the neighbor pointers of itself and its neighbors
     if(hasChunkAt(x, z + 16)) {
-        auto &chunkNorth = m_chunks[toKey(x, z + 16)];
+        auto &chunkNorth = m_chunks.at(toKey(x, z + 16));
         cPtr->linkNeighbor(chunkNorth, Direction::ZPOS);
     }
     if(hasChunkAt(x, z - 16)) {
-        auto &chunkSouth = m_chunks[toKey(x, z - 16)];
+        auto &chunkSouth = m_chunks.at(toKey(x, z - 16));
         cPtr->linkNeighbor(chunkSouth, Direction::ZNEG);
     }
     if(hasChunkAt(x + 16, z)) {
-        auto &chunkEast = m_chunks[toKey(x + 16, z)];
+        auto &chunkEast = m_chunks.at(toKey(x + 16, z));
         cPtr->linkNeighbor(chunkEast, Direction::XPOS);
     }
     if(hasChunkAt(x - 16, z)) {
-        auto &chunkWest = m_chunks[toKey(x - 16, z)];
+        auto &chunkWest = m_chunks.at(toKey(x - 16, z));
         cPtr->linkNeighbor(chunkWest, Direction::XNEG);
     }
     return cPtr;
 }
 
-// TODO: When you make Chunk inherit from Drawable, change this code so
-// it draws each Chunk with the given ShaderProgram, remembering to set the
-// model matrix to the proper X and Z translation!
-void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram) {
+std::vector<Chunk*> Terrain::getChunksFrontToBack(int minX, int maxX, int minZ, int maxZ, glm::vec3 eye) {
+    std::vector<std::pair<float, Chunk*>> sorted;
 
     for(int x = minX; x < maxX; x += 16) {
         for(int z = minZ; z < maxZ; z += 16) {
+            if(hasChunkAt(x, z)) {
+                // Chunks span the full height of the world, so only
+                // the x-z distance to their center matters
+                glm::vec2 toCenter = glm::vec2(x + 8, z + 8) - glm::vec2(eye.x, eye.z);
+                sorted.push_back({glm::dot(toCenter, toCenter), getChunkAt(x, z).get()});
+            }
+        }
+    }
+
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<float, Chunk*> &a, const std::pair<float, Chunk*> &b) {
+                  return a.first < b.first;
+              });
+
+    std::vector<Chunk*> chunks;
+    chunks.reserve(sorted.size());
+    for(auto &p : sorted) {
+        chunks.push_back(p.second);
+    }
+    return chunks;
+}
+
+// Given in lecture
+bool Terrain::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, float *out_dist, glm::ivec3 *out_blockHit, float *axis) const {
+    float maxLen = glm::length(rayDirection); // Farthest we search
+    glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
+    rayDirection = glm::normalize(rayDirection); // Now all t values represent world dist.
+
+    while(true) {
+        // Every t is measured from the ray's origin, and the cell is stepped
+        // one block at a time rather than found by flooring a point moved
+        // along the ray, which rounding could leave on the wrong side of a
+        // boundary and so skip a cell
+        float min_t = std::numeric_limits<float>::infinity();
+        int interfaceAxis = -1; // Track axis for which t is smallest
+        for(int i = 0; i < 3; ++i) { // Iterate over the three axes
+            if(rayDirection[i] != 0) { // Is ray parallel to axis i?
+                int nextIntercept = currCell[i] + (rayDirection[i] > 0 ? 1 : 0);
+                float axis_t = (nextIntercept - rayOrigin[i]) / rayDirection[i];
+                if(axis_t < min_t) {
+                    min_t = axis_t;
+                    interfaceAxis = i;
+                }
+            }
+        }
+        if(interfaceAxis == -1) {
+            throw std::out_of_range("interfaceAxis was -1 after the for loop in gridMarch!");
+        }
+        // Blocks beyond the end of the ray aren't tested
+        if(min_t > maxLen) {
+            *out_dist = maxLen;
+            return false;
+        }
+        currCell[interfaceAxis] += rayDirection[interfaceAxis] > 0 ? 1 : -1;
+        // Above or below the world there is nothing to hit, and a ray
+        // heading further away will never come back
+        if((currCell.y < 0 && rayDirection.y <= 0) || (currCell.y > 255 && rayDirection.y >= 0)) {
+            *out_dist = maxLen;
+            return false;
+        }
+        if(currCell.y < 0 || currCell.y > 255) {
+            continue;
+        }
+        // If currCell contains something other than EMPTY, return
+        // min_t. Unloaded cells end the march without a hit.
+        BlockType cellType;
+        if(!tryGetBlockAt(currCell.x, currCell.y, currCell.z, &cellType)) {
+            *out_dist = min_t;
+            return false;
+        }
+        if(cellType != BlockType::EMPTY) {
+            *out_blockHit = currCell;
+            *out_dist = min_t;
+            *axis = interfaceAxis;
+            return true;
+        }
+    }
+}
+
+RayHit Terrain::raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance) const {
+    RayHit hit;
+    float len = glm::length(direction);
+    if(len == 0.f || !(maxDistance > 0.f)) {
+        return hit;
+    }
+    glm::vec3 d = direction / len;
 
-            Chunk* c = getChunkAt(x, z).get();
+    // A DDA over the integer block grid (Amanatides & Woo): each step
+    // only adds to the cell coordinates and the distances to the next
+    // boundary on each axis, instead of flooring the ray's position
+    glm::ivec3 cell = glm::ivec3(glm::floor(origin));
+    glm::ivec3 step(0);
+    glm::vec3 next(std::numeric_limits<float>::infinity());
+    glm::vec3 delta(std::numeric_limits<float>::infinity());
+    for(int i = 0; i < 3; ++i) {
+        if(d[i] != 0.f) {
+            step[i] = d[i] > 0.f ? 1 : -1;
+            delta[i] = 1.f / glm::abs(d[i]);
+            next[i] = (cell[i] + (step[i] > 0) - origin[i]) / d[i];
+        }
+    }
 
-            //c->createVBOdata();
+    // The Chunk holding the current cell is kept until the ray leaves it,
+    // rather than looked up in m_chunks at every cell
+    const Chunk *chunk = nullptr;
+    glm::ivec2 chunkOrigin(0);
+    while(true) {
+        int axis = next.x <= next.y ? (next.x <= next.z ? 0 : 2) : (next.y <= next.z ? 1 : 2);
+        float t = next[axis];
+        // Blocks beyond the end of the ray aren't tested
+        if(t > maxDistance) {
+            hit.distance = maxDistance;
+            return hit;
+        }
+        cell[axis] += step[axis];
+        next[axis] += delta[axis];
 
-            shaderProgram->setModelMatrix(translate(mat4(), vec3(x,0,z)));
-            shaderProgram->drawInterleaved(*c);
+        if(cell.y < 0 || cell.y > 255) {
+            // Above or below the world nothing can be hit, and a ray
+            // heading further away will never come back, so it goes
+            // the whole way
+            if((cell.y < 0 && step.y <= 0) || (cell.y > 255 && step.y >= 0)) {
+                hit.distance = maxDistance;
+                return hit;
+            }
+            continue;
+        }
+        if(chunk == nullptr || static_cast<unsigned int>(cell.x - chunkOrigin.x) > 15 ||
+           static_cast<unsigned int>(cell.z - chunkOrigin.y) > 15) {
+            chunk = findChunkAt(cell.x, cell.z);
+            if(chunk == nullptr) {
+                // Left the loaded world
+                hit.distance = t;
+                return hit;
+            }
+            chunkOrigin = chunk->getOrigin();
+        }
+        if(!chunk->isEmptyAt(static_cast<unsigned int>(cell.x - chunkOrigin.x), static_cast<unsigned int>(cell.y),
+                             static_cast<unsigned int>(cell.z - chunkOrigin.y))) {
+            hit.hit = true;
+            hit.block = cell;
+            hit.normal[axis] = -step[axis];
+            hit.distance = t;
+            return hit;
         }
     }
+}
 
+void Terrain::raycast(const glm::vec3 *origins, const glm::vec3 *directions, const float *maxDistances,
+                      int count, RayHit *out) const {
+    for(int i = 0; i < count; ++i) {
+        out[i] = raycast(origins[i], directions[i], maxDistances[i]);
+    }
+}
 
+void Terrain::setSeed(int seed) {
+    m_seed = seed;
+}
+
+int Terrain::getSeed() const {
+    return m_seed;
+}
+
+void Terrain::setBiomeSampling(int step, float maxError) {
+    // The lattice has to line up with the edges of every Chunk
+    m_biomeStep = 1;
+    while(m_biomeStep * 2 <= glm::min(step, 16)) {
+        m_biomeStep *= 2;
+    }
+    m_biomeMaxError = maxError;
+}
+
+void Terrain::setCavesEnabled(bool enabled) {
+    m_caves = enabled;
+}
+
+void Terrain::setThreadPool(ThreadPool *threads) {
+    mp_threads = threads;
 }
 
 void Terrain::generateTerrain(int x_start, int z_start){
@@ -171,40 +382,491 @@ void Terrain::generateTerrain(int x_start, int z_start){
     if(m_generatedTerrain.count(toKey(x_start, z_start)) > 0) {
         return;
     }
-
-    // Create the Chunks that will
-    // store the blocks for our
-    // initial world space
-    for(int x = x_start; x < x_start + 64; x += 16) {
-        for(int z = z_start; z < z_start + 64; z += 16) {
-            instantiateChunkAt(x, z);
-        }
-    }
+    PROFILE_ZONE("Terrain::generateTerrain");
 
     // Tell our existing terrain set that
     // the "generated terrain zone" at (0,0)
     // now exists.
     m_generatedTerrain.insert(toKey(x_start, z_start));
 
-    // generate terrain
-    for (int x = x_start; x < x_start + 64; x++)
-    {
-        for (int z = z_start; z < z_start + 64; z++)
-        {
+    generateArea(x_start, x_start + 64, z_start, z_start + 64);
+
+    // The new Chunks are meshed by the renderer once
+    // their neighbors have been generated too
+}
+
+void Terrain::generateArea(int minX, int maxX, int minZ, int maxZ) {
+    std::vector<glm::ivec2> origins;
+    for(int x = 16 * static_cast<int>(glm::floor(minX / 16.f)); x < maxX; x += 16) {
+        for(int z = 16 * static_cast<int>(glm::floor(minZ / 16.f)); z < maxZ; z += 16) {
+            origins.push_back(glm::ivec2(x, z));
+        }
+    }
+    generateChunks(origins);
+}
+
+void Terrain::requestChunks(int minX, int maxX, int minZ, int maxZ) {
+    for(int x = 16 * static_cast<int>(glm::floor(minX / 16.f)); x < maxX; x += 16) {
+        for(int z = 16 * static_cast<int>(glm::floor(minZ / 16.f)); z < maxZ; z += 16) {
+            const Chunk *c = findChunkAt(x, z);
+            if(c == nullptr || c->getStage() != ChunkStage::LIT) {
+                m_requestedChunks.insert(toKey(x, z));
+            }
+        }
+    }
+}
+
+int Terrain::generateRequested(int maxChunks, glm::vec3 focus) {
+    if(m_requestedChunks.empty() || maxChunks <= 0) {
+        return static_cast<int>(m_requestedChunks.size());
+    }
+
+    std::vector<std::pair<float, glm::ivec2>> queued;
+    queued.reserve(m_requestedChunks.size());
+    for(int64_t key : m_requestedChunks) {
+        glm::ivec2 origin = toCoords(key);
+        glm::vec2 toCenter = glm::vec2(origin.x + 8, origin.y + 8) - glm::vec2(focus.x, focus.z);
+        queued.push_back({glm::dot(toCenter, toCenter), origin});
+    }
+    int count = glm::min(maxChunks, static_cast<int>(queued.size()));
+    std::partial_sort(queued.begin(), queued.begin() + count, queued.end(),
+                      [](const std::pair<float, glm::ivec2> &a, const std::pair<float, glm::ivec2> &b) {
+                          return a.first < b.first;
+                      });
+
+    std::vector<glm::ivec2> origins;
+    for(int i = 0; i < count; ++i) {
+        origins.push_back(queued[i].second);
+        m_requestedChunks.erase(toKey(queued[i].second.x, queued[i].second.y));
+    }
+    generateChunks(origins);
+    return static_cast<int>(m_requestedChunks.size());
+}
+
+int Terrain::requestedCount() const {
+    return static_cast<int>(m_requestedChunks.size());
+}
+
+int Terrain::unloadChunksOutside(int minX, int maxX, int minZ, int maxZ) {
+    PROFILE_ZONE("Terrain::unloadChunksOutside");
+    std::vector<Chunk*> outside;
+    m_chunks.forEach([&](Chunk *c) {
+        glm::ivec2 origin = c->getOrigin();
+        if(origin.x + 16 <= minX || origin.x >= maxX || origin.y + 16 <= minZ || origin.y >= maxZ) {
+            outside.push_back(c);
+        }
+    });
+    std::vector<glm::ivec2> origins;
+    for(Chunk *c : outside) {
+        glm::ivec2 origin = c->getOrigin();
+        c->unlinkNeighbors();
+        m_generatedTerrain.erase(toKey(chunkCorner64(origin.x), chunkCorner64(origin.y)));
+        m_chunkPool.release(m_chunks.remove(toKey(origin.x, origin.y)));
+        origins.push_back(origin);
+    }
+    forgetFeaturesAround(origins);
+    return static_cast<int>(outside.size());
+}
+
+void Terrain::forgetFeaturesAround(const std::vector<glm::ivec2> &unloaded) {
+    // Only Chunks next to one just unloaded can have lost their last
+    // loaded neighbor
+    std::vector<glm::ivec2> forgotten;
+    for(const glm::ivec2 &origin : unloaded) {
+        for(int dz = -16; dz <= 16; dz += 16) {
+            for(int dx = -16; dx <= 16; dx += 16) {
+                glm::ivec2 source = origin + glm::ivec2(dx, dz);
+                if(m_featureSources.count(toKey(source.x, source.y)) == 0) {
+                    continue;
+                }
+                bool isolated = true;
+                for(int nz = -16; nz <= 16 && isolated; nz += 16) {
+                    for(int nx = -16; nx <= 16 && isolated; nx += 16) {
+                        isolated = findChunkAt(source.x + nx, source.y + nz) == nullptr;
+                    }
+                }
+                if(isolated) {
+                    m_featureSources.erase(toKey(source.x, source.y));
+                    forgotten.push_back(source);
+                }
+            }
+        }
+    }
+
+    // Their blocks are filed again when they're decorated anew, and set
+    // right away in any neighbor that has been filled by then
+    for(const glm::ivec2 &source : forgotten) {
+        int64_t key = toKey(source.x, source.y);
+        for(int dz = -16; dz <= 16; dz += 16) {
+            for(int dx = -16; dx <= 16; dx += 16) {
+                auto pending = m_pendingBlocks.find(toKey(source.x + dx, source.y + dz));
+                if(pending == m_pendingBlocks.end()) {
+                    continue;
+                }
+                std::vector<PendingBlock> &blocks = pending->second;
+                blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                            [key](const PendingBlock &b) { return b.source == key; }),
+                             blocks.end());
+                if(blocks.empty()) {
+                    m_pendingBlocks.erase(pending);
+                }
+            }
+        }
+    }
+}
+
+int Terrain::chunkCount() const {
+    return m_chunks.size();
+}
+
+const ChunkPool& Terrain::getChunkPool() const {
+    return m_chunkPool;
+}
+
+int Terrain::pendingBlockCount() const {
+    int count = 0;
+    for(const auto &pending : m_pendingBlocks) {
+        count += static_cast<int>(pending.second.size());
+    }
+    return count;
+}
+
+int Terrain::featureSourceCount() const {
+    return static_cast<int>(m_featureSources.size());
+}
+
+void Terrain::generateChunks(const std::vector<glm::ivec2> &origins) {
+    PROFILE_ZONE("Terrain::generateChunks");
+    // Instantiating links neighbors, which touches the Chunk map,
+    // so it happens up front on this thread
+    std::vector<Chunk*> chunks;
+    for(const glm::ivec2 &origin : origins) {
+        Chunk *c = findChunkAt(origin.x, origin.y);
+        if(c == nullptr) {
+            c = instantiateChunkAt(origin.x, origin.y);
+        }
+        if(c->getStage() != ChunkStage::LIT) {
+            chunks.push_back(c);
+        }
+    }
+    if(chunks.empty()) {
+        return;
+    }
+
+    // Runs one stage over every Chunk of the batch that has finished the one before
+    auto runStage = [&](ChunkStage stage, void (Terrain::*work)(Chunk*), bool parallel) {
+        std::vector<Chunk*> ready;
+        for(Chunk *c : chunks) {
+            if(static_cast<int>(c->getStage()) + 1 == static_cast<int>(stage)) {
+                ready.push_back(c);
+            }
+        }
+        auto body = [&](int begin, int end) {
+            for(int i = begin; i < end; ++i) {
+                (this->*work)(ready[i]);
+                ready[i]->setStage(stage);
+            }
+        };
+        if(parallel && mp_threads != nullptr) {
+            mp_threads->parallelFor(static_cast<int>(ready.size()), 1, body);
+        } else {
+            body(0, static_cast<int>(ready.size()));
+        }
+    };
+    runStage(ChunkStage::HEIGHTMAP, &Terrain::generateHeightMap, true);
+    runStage(ChunkStage::FILLED, &Terrain::fillChunk, true);
+    runStage(ChunkStage::DECORATED, &Terrain::decorateChunk, false);
+
+    // Features reaching into Chunks lit by an earlier batch are relit like block edits
+    for(const auto &edit : m_featureEdits) {
+        Lighting::updateBlock(*this, edit.first, edit.second);
+    }
+    m_featureEdits.clear();
+
+    // Light crosses Chunk borders, so the whole batch is lit together
+    std::vector<Chunk*> unlit;
+    for(Chunk *c : chunks) {
+        if(c->getStage() == ChunkStage::DECORATED) {
+            unlit.push_back(c);
+        }
+    }
+    Lighting::lightChunks(unlit);
+    for(Chunk *c : unlit) {
+        c->setStage(ChunkStage::LIT);
+    }
+}
+
+void Terrain::generateHeightMap(Chunk *c) {
+    glm::ivec2 origin = c->getOrigin();
+    std::array<float, 16 * 16> biomes;
+    fillBiomeWeights(origin.x, origin.y, biomes.data());
+    for(unsigned int z = 0; z < 16; ++z) {
+        for(unsigned int x = 0; x < 16; ++x) {
+            float biome = biomes[x + 16 * z];
+            c->setBiomeWeight(x, z, biome);
+            c->setTerrainHeight(x, z, heightMapTerrain(origin.x + x, origin.y + z, biome));
+        }
+    }
+}
+
+void Terrain::fillChunk(Chunk *c) {
+    glm::ivec2 origin = c->getOrigin();
+    for(int x = origin.x; x < origin.x + 16; ++x) {
+        for(int z = origin.y; z < origin.y + 16; ++z) {
             setColumnAt(x, z);
         }
     }
+    if(m_caves) {
+        carveCaves(c);
+    }
+}
 
-    // Create the Chunks that will
-    // store the blocks for our
-    // initial world space
-    for(int x = x_start; x < x_start + 64; x += 16) {
-        for(int z = z_start; z < z_start + 64; z += 16) {
-            Chunk* c = getChunkAt(x, z).get();
-            c->createVBOdata();
+// Chance of a feature growing from a column of each biome
+static const float TREE_CHANCE = 0.01f;
+static const float BOULDER_CHANCE = 0.0025f;
+static const int SEA_LEVEL = 138;
+
+// The random state of a world-space column, so every feature is chosen
+// by its seed and position alone
+static uint32_t columnRandom(int seed, int x, int z) {
+    uint32_t h = static_cast<uint32_t>(seed) * 0x9E3779B9u;
+    h ^= static_cast<uint32_t>(x) * 0x85EBCA6Bu;
+    h ^= static_cast<uint32_t>(z) * 0xC2B2AE35u;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    // xorshift gets stuck on 0
+    return h != 0 ? h : 1u;
+}
+
+// Advances a xorshift32 state and returns a float in [0, 1)
+static float nextRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (x >> 8) * (1.f / 16777216.f);
+}
+
+// Which blocks a feature may replace: anything ranked lower. Terrain
+// ranks above every feature block.
+static int featureRank(const BlockType &t) {
+    if(t == BlockType::EMPTY) {
+        return 0;
+    } else if(t == BlockType::LEAVES) {
+        return 1;
+    } else if(t == BlockType::WOOD) {
+        return 2;
+    } else if(t == BlockType::STONE) {
+        return 3;
+    }
+    return 4;
+}
+
+void Terrain::decorateChunk(Chunk *c) {
+    PROFILE_ZONE("Terrain::decorateChunk");
+    glm::ivec2 origin = c->getOrigin();
+
+    // Blocks of neighbors' features that reached in, including those
+    // decorated before this Chunk was filled
+    int64_t key = toKey(origin.x, origin.y);
+    auto pending = m_pendingBlocks.find(key);
+    if(pending != m_pendingBlocks.end()) {
+        for(const PendingBlock &b : pending->second) {
+            setFeatureBlock(c, b);
+        }
+    }
+
+    // Only the height map is read, never the blocks, since
+    // features placed by neighbors may already be here
+    for(int z = 0; z < 16; ++z) {
+        for(int x = 0; x < 16; ++x) {
+            int h = c->getTerrainHeight(x, z);
+            if(h < SEA_LEVEL) {
+                continue;
+            }
+            uint32_t rng = columnRandom(m_seed, origin.x + x, origin.y + z);
+            float roll = nextRandom(&rng);
+            glm::ivec3 pos(origin.x + x, h + 1, origin.y + z);
+            if(c->getBiomeWeight(x, z) > .5f) {
+                if(roll < BOULDER_CHANCE) {
+                    placeBoulder(pos, &rng);
+                }
+            } else if(roll < TREE_CHANCE) {
+                placeTree(pos, &rng);
+            }
+        }
+    }
+
+    // Blocks landing in other Chunks are filed for them, once, and set
+    // now in those that are filled already
+    bool file = m_featureSources.insert(key).second;
+    for(const PendingBlock &b : m_featureBlocks) {
+        int64_t target = toKey(chunkCorner(b.pos.x), chunkCorner(b.pos.z));
+        Chunk *holder = target == key ? c : findChunkAt(b.pos.x, b.pos.z);
+        if(target != key && file) {
+            m_pendingBlocks[target].push_back(PendingBlock{b.pos, b.type, key});
+        }
+        if(holder != nullptr && static_cast<int>(holder->getStage()) >= static_cast<int>(ChunkStage::FILLED)) {
+            setFeatureBlock(holder, b);
+        }
+    }
+    m_featureBlocks.clear();
+}
+
+void Terrain::placeFeatureBlock(glm::ivec3 pos, const BlockType &t) {
+    if(pos.y >= 0 && pos.y <= 255) {
+        m_featureBlocks.push_back(PendingBlock{pos, &t, 0});
+    }
+}
+
+void Terrain::setFeatureBlock(Chunk *c, const PendingBlock &b) {
+    glm::ivec2 origin = c->getOrigin();
+    glm::ivec3 local(b.pos.x - origin.x, b.pos.y, b.pos.z - origin.y);
+    BlockType old = c->getBlockAt(local);
+    if(featureRank(*b.type) <= featureRank(old)) {
+        return;
+    }
+    c->setBlockAt(local.x, local.y, local.z, *b.type);
+    if(c->getStage() == ChunkStage::LIT) {
+        m_featureEdits.push_back(std::make_pair(b.pos, old));
+    }
+}
+
+void Terrain::placeTree(glm::ivec3 pos, uint32_t *rng) {
+    int trunk = 4 + static_cast<int>(3.f * nextRandom(rng));
+    for(int y = 0; y < trunk; ++y) {
+        placeFeatureBlock(pos + glm::ivec3(0, y, 0), BlockType::WOOD);
+    }
+
+    // Two wide layers of leaves around the top of the trunk and two narrow
+    // ones above it, with the corners trimmed off (some of them at random)
+    int top = pos.y + trunk;
+    for(int y = top - 2; y <= top + 1; ++y) {
+        int r = y < top ? 2 : 1;
+        for(int dz = -r; dz <= r; ++dz) {
+            for(int dx = -r; dx <= r; ++dx) {
+                bool corner = glm::abs(dx) == r && glm::abs(dz) == r;
+                if((corner && (y == top + 1 || nextRandom(rng) < .5f)) || (dx == 0 && dz == 0 && y < top)) {
+                    continue;
+                }
+                placeFeatureBlock(glm::ivec3(pos.x + dx, y, pos.z + dz), BlockType::LEAVES);
+            }
+        }
+    }
+}
+
+void Terrain::placeBoulder(glm::ivec3 pos, uint32_t *rng) {
+    // Half sunk into the ground
+    float radius = 1.f + 1.2f * nextRandom(rng);
+    int r = static_cast<int>(glm::ceil(radius));
+    for(int dy = -r; dy <= r; ++dy) {
+        for(int dz = -r; dz <= r; ++dz) {
+            for(int dx = -r; dx <= r; ++dx) {
+                if(dx * dx + dy * dy + dz * dz <= radius * radius) {
+                    placeFeatureBlock(pos + glm::ivec3(dx, dy - 1, dz), BlockType::STONE);
+                }
+            }
+        }
+    }
+}
+
+// Cave noise is only evaluated on a lattice this many blocks apart
+// and trilinearly interpolated in between
+static const int CAVE_STEP_XZ = 4;
+static const int CAVE_STEP_Y = 8;
+// Blocks whose cave noise is above this are hollowed out
+static const float CAVE_THRESHOLD = 0.4f;
+// The lowest block a cave can reach, and how many solid blocks are
+// kept between a cave and the ground (or the sea floor) above it
+static const int CAVE_FLOOR = 4;
+static const int CAVE_ROOF = 6;
+
+void Terrain::carveCaves(Chunk *c) {
+    PROFILE_ZONE("Terrain::carveCaves");
+    int tops[16][16]; // The highest block each column may be carved up to
+    int top = -1;
+    for(int x = 0; x < 16; ++x) {
+        for(int z = 0; z < 16; ++z) {
+            tops[x][z] = c->getTerrainHeight(x, z) - CAVE_ROOF;
+            top = glm::max(top, tops[x][z]);
+        }
+    }
+    if(top < CAVE_FLOOR) {
+        return;
+    }
+
+    // Noise at every corner of the lattice, from y = 0 to just above top
+    glm::ivec2 origin = c->getOrigin();
+    const int pointsXZ = 16 / CAVE_STEP_XZ + 1;
+    const int pointsY = top / CAVE_STEP_Y + 2;
+    std::vector<float> lattice(pointsXZ * pointsXZ * pointsY);
+    auto sample = [&](int i, int j, int k) {
+        return lattice[i + pointsXZ * (k + pointsXZ * j)];
+    };
+    for(int j = 0; j < pointsY; ++j) {
+        for(int k = 0; k < pointsXZ; ++k) {
+            for(int i = 0; i < pointsXZ; ++i) {
+                lattice[i + pointsXZ * (k + pointsXZ * j)] =
+                        caveNoise(origin.x + i * CAVE_STEP_XZ, j * CAVE_STEP_Y, origin.y + k * CAVE_STEP_XZ);
+            }
         }
     }
 
+    const int cellsPerSection = 16 / CAVE_STEP_Y;
+    for(int j0 = 0; j0 * CAVE_STEP_Y <= top; j0 += cellsPerSection) {
+        int j1 = glm::min(j0 + cellsPerSection, pointsY - 1);
+        // Trilinear interpolation never rises above the highest of its
+        // corners, so a 16-block section whose samples all lie below the
+        // threshold can't hold a cave. Most sections are skipped here.
+        float highest = -std::numeric_limits<float>::max();
+        for(int j = j0; j <= j1; ++j) {
+            for(int k = 0; k < pointsXZ; ++k) {
+                for(int i = 0; i < pointsXZ; ++i) {
+                    highest = glm::max(highest, sample(i, j, k));
+                }
+            }
+        }
+        if(highest <= CAVE_THRESHOLD) {
+            continue;
+        }
+
+        for(int j = j0; j < j1; ++j) {
+            for(int k = 0; k < pointsXZ - 1; ++k) {
+                for(int i = 0; i < pointsXZ - 1; ++i) {
+                    float n000 = sample(i, j, k), n100 = sample(i + 1, j, k);
+                    float n001 = sample(i, j, k + 1), n101 = sample(i + 1, j, k + 1);
+                    float n010 = sample(i, j + 1, k), n110 = sample(i + 1, j + 1, k);
+                    float n011 = sample(i, j + 1, k + 1), n111 = sample(i + 1, j + 1, k + 1);
+                    // The same test for each cell
+                    if(glm::max(glm::max(glm::max(n000, n100), glm::max(n001, n101)),
+                                glm::max(glm::max(n010, n110), glm::max(n011, n111))) <= CAVE_THRESHOLD) {
+                        continue;
+                    }
+
+                    for(int dy = 0; dy < CAVE_STEP_Y; ++dy) {
+                        int y = j * CAVE_STEP_Y + dy;
+                        if(y < CAVE_FLOOR || y > top) {
+                            continue;
+                        }
+                        float v = dy / static_cast<float>(CAVE_STEP_Y);
+                        for(int dz = 0; dz < CAVE_STEP_XZ; ++dz) {
+                            float w = dz / static_cast<float>(CAVE_STEP_XZ);
+                            float n0 = glm::mix(glm::mix(n000, n001, w), glm::mix(n010, n011, w), v);
+                            float n1 = glm::mix(glm::mix(n100, n101, w), glm::mix(n110, n111, w), v);
+                            for(int dx = 0; dx < CAVE_STEP_XZ; ++dx) {
+                                int x = i * CAVE_STEP_XZ + dx, z = k * CAVE_STEP_XZ + dz;
+                                if(y <= tops[x][z] && glm::mix(n0, n1, dx / static_cast<float>(CAVE_STEP_XZ)) > CAVE_THRESHOLD) {
+                                    c->setBlockAt(x, y, z, BlockType::EMPTY);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
 }
 
 
@@ -251,28 +913,21 @@ void Terrain::CreateTestScene()
     }
 
     setBlockAt(32, 139, 32, BlockType::STONE);
-
-    for(int x = 0; x < 64; x += 16) {
-        for(int z = 0; z < 64; z += 16) {
-
-            Chunk* c = getChunkAt(x, z).get();
-
-            c->createVBOdata();
-
-        }
-    }
-
-
 }
 
 
+// The FBM behind each height map, with its octave weights worked out once
+static const FBMParameters<> GRASSLAND_FBM(.6f, 333);
+static const FBMParameters<> MOUNTAIN_FBM(.5f, 200);
+static const FBMParameters<> BIOME_FBM(.9f, 2345);
+
 // get the height of the given x-z coords - GRASSLAND
 int Terrain::heightMapGrassland(int x, int z)
 {
     // use perturbed perlin noise to create grasslands
     float min = 1.4;
     float max = 2.6;
-    float h = Noise::hybridMultiFractalInv(x, z, m_seed, .6, 333);
+    float h = Noise::hybridMultiFractal<RidgedPerlin>(GRASSLAND_FBM, x, z, m_seed);
     //std::cout << h << std::endl;;
     h = glm::clamp(h, min, max);
     return 66 * glm::smoothstep(min, max, h) + 111;
@@ -284,36 +939,124 @@ int Terrain::heightMapMountains(int x, int z)
     // use perlin noise based FBM to create mountains
     float min = .9;
     float max = 1.7;
-    float h = Noise::hybridMultiFractal(x, z, m_seed, .5, 200);
+    float h = Noise::hybridMultiFractal<RidgedPerlin>(MOUNTAIN_FBM, x, z, m_seed);
     h = glm::clamp(h, min, max);
     return 80 * glm::smoothstep(min, max, h) + 100;
 }
 
+// turn the biome noise into a weight from 0 (grassland) to 1 (mountains)
+static float biomeWeightOf(float noise)
+{
+    float min = 1.5;
+    float max = 1.8;
+    noise = glm::clamp(noise, min, max);
+    return glm::smoothstep(min, max, noise);
+}
+
 // get the "height" of the biome map
 float Terrain::heightMapBiome(int x, int z)
 {
     // use perlin-based noise map to LERP b/w biomes
-    float min = 1.5;
-    float max = 1.8;
-    float biomeScale = 2345;
-    float biome = Noise::hybridMultiFractal(x, z, m_seed, .9, biomeScale);
-    //std::cout << biome;// << std::endl;
-    biome = glm::clamp(biome, min, max);
-    biome = glm::smoothstep(min, max, biome);
-    //std::cout << ", " << biome << std::endl;
-    return biome;
+    return biomeWeightOf(biomeNoise(x, z));
 }
 
-// populate all terrain for given x-z cooreds (y column)
-void Terrain::setColumnAt(int x, int z)
+float Terrain::biomeNoise(int x, int z)
+{
+    return Noise::hybridMultiFractal<RidgedPerlin>(BIOME_FBM, x, z, m_seed);
+}
+
+float Terrain::caveNoise(int x, int y, int z)
+{
+    // Squashed vertically, so caves spread out into wide chambers
+    // more than they climb. Each octave gets its own seed.
+    glm::vec3 p(x / 48.f, y / 20.f, z / 48.f);
+    return Noise::perlin3D(p, m_seed) + 0.5f * Noise::perlin3D(2.f * p, m_seed + 1);
+}
+
+void Terrain::fillBiomeWeights(int x_start, int z_start, float *weights)
+{
+    PROFILE_ZONE("Terrain::fillBiomeWeights");
+    const int step = m_biomeStep;
+    if (step == 1) {
+        for (int z = 0; z < 16; z++) {
+            for (int x = 0; x < 16; x++) {
+                weights[x + 16 * z] = heightMapBiome(x_start + x, z_start + z);
+            }
+        }
+        return;
+    }
+
+    // Noise at every corner of the lattice, including the far edges of the Chunk
+    const int points = 16 / step + 1;
+    std::vector<float> lattice(points * points);
+    for (int j = 0; j < points; j++) {
+        for (int i = 0; i < points; i++) {
+            lattice[i + points * j] = biomeNoise(x_start + i * step, z_start + j * step);
+        }
+    }
+
+    for (int j = 0; j < points - 1; j++) {
+        for (int i = 0; i < points - 1; i++) {
+            float n00 = lattice[i + points * j], n10 = lattice[i + 1 + points * j];
+            float n01 = lattice[i + points * (j + 1)], n11 = lattice[i + 1 + points * (j + 1)];
+            int x0 = i * step, z0 = j * step;
+
+            // Interpolation strays furthest from the noise away from the
+            // corners, so exact samples at the middle of the cell and of each
+            // of its edges tell if the cell is smooth enough. That is a
+            // heuristic, not a guarantee: noise finer than half a cell can
+            // still slip between the samples (the generation benchmark checks
+            // every column against the bound). The noise is interpolated
+            // rather than the weight so that the clamped (fully grassland or
+            // mountain) areas stay exact.
+            const int half = step / 2;
+            const glm::ivec2 probes[5] = {glm::ivec2(half, half), glm::ivec2(half, 0), glm::ivec2(0, half),
+                                          glm::ivec2(half, step), glm::ivec2(step, half)};
+            bool exact = false;
+            for (int p = 0; p < 5 && !exact; p++) {
+                float u = probes[p].x / static_cast<float>(step), v = probes[p].y / static_cast<float>(step);
+                float interpolated = biomeWeightOf(glm::mix(glm::mix(n00, n10, u), glm::mix(n01, n11, u), v));
+                float sampled = heightMapBiome(x_start + x0 + probes[p].x, z_start + z0 + probes[p].y);
+                exact = glm::abs(interpolated - sampled) > m_biomeMaxError;
+            }
+
+            for (int dz = 0; dz < step; dz++) {
+                for (int dx = 0; dx < step; dx++) {
+                    float w;
+                    if (exact) {
+                        w = heightMapBiome(x_start + x0 + dx, z_start + z0 + dz);
+                    } else {
+                        float u = dx / static_cast<float>(step), v = dz / static_cast<float>(step);
+                        w = biomeWeightOf(glm::mix(glm::mix(n00, n10, u), glm::mix(n01, n11, u), v));
+                    }
+                    weights[(x0 + dx) + 16 * (z0 + dz)] = w;
+                }
+            }
+        }
+    }
+}
+
+// get the ground height of the given x-z coords
+int Terrain::heightMapTerrain(int x, int z, float biome)
 {
-    float biome = heightMapBiome(x, z);
     // get the heights of each biome
     int heightGrassland = heightMapGrassland(x, z);
     int heightMountains = heightMapMountains(x, z);
 
     // LERP between each biome's height map
-    int h = heightGrassland * (1 - biome) + heightMountains * biome;
+    return heightGrassland * (1 - biome) + heightMountains * biome;
+}
+
+// populate all terrain for given x-z cooreds (y column)
+void Terrain::setColumnAt(int x, int z)
+{
+    PROFILE_ZONE("Terrain::setColumnAt");
+    Chunk *c = findChunkAt(x, z);
+    glm::ivec2 chunkOrigin = c->getOrigin();
+    unsigned int localX = static_cast<unsigned int>(x - chunkOrigin.x);
+    unsigned int localZ = static_cast<unsigned int>(z - chunkOrigin.y);
+    float biome = c->getBiomeWeight(localX, localZ);
+    int h = c->getTerrainHeight(localX, localZ);
 
     // call biome specific column function based on larger value
     if (biome > .5)
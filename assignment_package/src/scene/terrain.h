@@ -2,15 +2,36 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include "chunk.h"
+#include "chunkmap.h"
+#include "chunkpool.h"
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
-#include "shaderprogram.h"
-#include "cube.h"
+#include <utility>
+#include <vector>
 
+class ThreadPool;
+
+// A block of a feature (a tree or boulder) being placed in the world
+struct PendingBlock {
+    glm::ivec3 pos; // World space
+    const BlockType *type;
+    int64_t source; // Origin key of the Chunk whose feature placed it, once filed
+};
 
 //using namespace std;
 
+// The result of casting one ray through the block grid
+struct RayHit {
+    bool hit;
+    glm::ivec3 block;  // The block that was hit
+    glm::ivec3 normal; // Normal of the face the ray entered that block through
+    float distance;    // Distance travelled along the ray (the whole way if it missed)
+
+    RayHit() : hit(false), block(0), normal(0), distance(0.f)
+    {}
+};
+
 // Helper functions to convert (x, z) to and from hash map key
 int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
@@ -26,7 +47,9 @@ private:
     // We combine the X and Z coordinates of the Chunk's corner into one 64-bit int
     // so that we can use them as a key for the map, as objects like std::pairs or
     // glm::ivec2s are not hashable by default, so they cannot be used as keys.
-    std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
+    ChunkMap m_chunks;
+    // Where unloaded Chunks go to be reused by instantiateChunkAt
+    ChunkPool m_chunkPool;
 
     // We will designate every 64 x 64 area of the world's x-z plane
     // as one "terrain generation zone". Every time the player moves
@@ -43,12 +66,76 @@ private:
     // in the Terrain will never be deleted until the program is terminated.
     std::unordered_set<int64_t> m_generatedTerrain;
 
-    int m_seed; // the random seed for the world
+    int m_seed; // the seed the whole world is generated from
+
+    // Biome weights change so slowly that generation only evaluates the
+    // biome noise every m_biomeStep blocks and interpolates in between.
+    // Any lattice cell whose interpolated weight is off by more than
+    // m_biomeMaxError at its center is evaluated exactly instead.
+    int m_biomeStep;
+    float m_biomeMaxError;
+
+    // Whether fillChunk carves caves out of the filled columns
+    bool m_caves;
+
+    // Every block a feature placed outside the Chunk it grew from, by the
+    // origin key of the Chunk it landed in. Each Chunk applies the blocks
+    // filed under it when it is decorated, which covers features of
+    // neighbors decorated before it was even instantiated, and again if it
+    // is unloaded and generated anew. Features never instantiate Chunks,
+    // so generation stays within the requested area however far a
+    // feature reaches. Features reach less than a Chunk, so each Chunk only
+    // files blocks for its 8 neighbors.
+    std::unordered_map<int64_t, std::vector<PendingBlock>> m_pendingBlocks;
+    // The Chunks whose features are already filed in m_pendingBlocks.
+    // A Chunk is forgotten here, along with the blocks it filed, once
+    // neither it nor any of its neighbors is loaded, so both stay bounded
+    // by the loaded area however far the player roams.
+    std::unordered_set<int64_t> m_featureSources;
+    // The blocks of the features of the Chunk being decorated
+    std::vector<PendingBlock> m_featureBlocks;
+    // Blocks that features changed in Chunks lit by an earlier batch, with
+    // the type each had before. They're relit once the whole batch has been
+    // decorated, so no light spreads past a block that is about to change.
+    std::vector<std::pair<glm::ivec3, BlockType>> m_featureEdits;
+
+    // Origins of the Chunks queued by requestChunks that haven't been lit yet
+    std::unordered_set<int64_t> m_requestedChunks;
+    // Runs the per-Chunk generation stages in parallel, if set
+    ThreadPool *mp_threads;
 
-    OpenGLContext* mp_context;
+    // Brings the Chunks with the given origins, instantiating any that don't
+    // exist yet, through every ChunkStage up to LIT. Each stage is run over
+    // all of them before the next starts, so a stage can rely on every Chunk
+    // of the batch having finished the one before.
+    void generateChunks(const std::vector<glm::ivec2> &origins);
+    // The stages that only touch their own Chunk, and so can run in parallel
+    void generateHeightMap(Chunk *c);
+    void fillChunk(Chunk *c);
+    void decorateChunk(Chunk *c);
+    // Hollows out caves wherever caveNoise rises above the cave threshold,
+    // below the ground of each column. Part of the FILLED stage.
+    void carveCaves(Chunk *c);
+    // Adds one block to the features of the Chunk being decorated
+    void placeFeatureBlock(glm::ivec3 pos, const BlockType &t);
+    // Sets a feature block in a filled Chunk. Where features overlap, the
+    // block that ranks higher (wood over leaves, stone over wood) wins
+    // whichever was placed first, and terrain is never replaced, so the
+    // world doesn't depend on decoration order.
+    void setFeatureBlock(Chunk *c, const PendingBlock &b);
+    // Features standing on the ground block below pos, shaped by rng
+    void placeTree(glm::ivec3 pos, uint32_t *rng);
+    void placeBoulder(glm::ivec3 pos, uint32_t *rng);
+    // Forgets the filed features of every Chunk around the given unloaded
+    // Chunks that has no loaded Chunk left around it. They're filed again
+    // if the Chunk is decorated anew.
+    void forgetFeaturesAround(const std::vector<glm::ivec2> &unloaded);
 
 public:
-    Terrain(OpenGLContext *context);
+    // The seed used unless setSeed is called
+    static const int DEFAULT_SEED = 1337;
+
+    explicit Terrain(int seed = DEFAULT_SEED);
     ~Terrain();
 
     // Instantiates a new Chunk and stores it in
@@ -68,21 +155,111 @@ public:
     // Assuming a Chunk exists at these coords,
     // return a const reference to it
     const uPtr<Chunk>& getChunkAt(int x, int z) const;
+    // Returns the Chunk containing these world-space coords,
+    // or nullptr if it hasn't been created yet
+    Chunk* findChunkAt(int x, int z);
+    const Chunk* findChunkAt(int x, int z) const;
     // Given a world-space coordinate (which may have negative
     // values) return the block stored at that point in space.
+    // Throws std::out_of_range if no Chunk exists there.
     BlockType getBlockAt(int x, int y, int z) const;
     BlockType getBlockAt(glm::vec3 p) const;
+    // Non-throwing version of getBlockAt for physics and picking,
+    // which routinely reach past the edge of the loaded world.
+    // Returns false, leaving out untouched, if no Chunk exists there.
+    bool tryGetBlockAt(int x, int y, int z, BlockType *out) const;
     // Given a world-space coordinate (which may have negative
     // values) set the block at that point in space to the
-    // given type.
+    // given type. Throws std::out_of_range if no Chunk exists there.
     void setBlockAt(int x, int y, int z, BlockType t);
+    // Non-throwing version of setBlockAt. Returns false if no
+    // Chunk exists there or y is outside the world.
+    bool trySetBlockAt(int x, int y, int z, BlockType t);
+    // Sets a block as a gameplay edit (e.g. the Player placing or breaking
+    // one), relighting the blocks around it. Terrain generation uses
+    // setBlockAt instead and lights each new terrain zone all at once.
+    // Returns false if no Chunk exists there or y is outside the world.
+    bool editBlockAt(int x, int y, int z, BlockType t);
+
+    // The height of the highest non-EMPTY block in the column at these
+    // world-space coords, or -1 if the column is all air or has no Chunk.
+    // Read from each Chunk's cached height map, so it costs no more than
+    // finding the Chunk.
+    int surfaceHeight(int x, int z) const;
+    // How mountainous the column at these world-space coords was generated,
+    // from 0 (grassland) to 1 (mountains), or -1 if it has no Chunk
+    float biomeWeight(int x, int z) const;
+
+    // Returns every Chunk that falls within the bounding box
+    // described by the min and max coords, sorted from nearest
+    // to farthest from the given eye position
+    std::vector<Chunk*> getChunksFrontToBack(int minX, int maxX, int minZ, int maxZ, glm::vec3 eye);
+
+    // Marches a ray through the block grid until it enters a non-EMPTY
+    // block or has travelled length(rayDirection). On a hit, returns true
+    // and outputs the distance travelled, the block hit and the axis (0, 1
+    // or 2) of the face it entered through. Rays stop, without a hit,
+    // where they enter an unloaded Chunk; those leaving through the top or
+    // bottom of the world can't hit anything, so they go the whole way.
+    bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, float *out_dist, glm::ivec3 *out_blockHit, float *axis) const;
 
-    // Draws every Chunk that falls within the bounding box
-    // described by the min and max coords, using the provided
-    // ShaderProgram
-    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
+    // Casts a ray of at most maxDistance blocks until it enters a non-EMPTY
+    // block. Like gridMarch, the block containing the origin isn't tested
+    // and rays end without a hit the same way.
+    RayHit raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance) const;
+    // Casts count rays, each with its own maximum distance, one after
+    // another, as raycast above would.
+    void raycast(const glm::vec3 *origins, const glm::vec3 *directions, const float *maxDistances,
+                 int count, RayHit *out) const;
 
+    // Generates and lights the 64 x 64 terrain generation zone with the given
+    // lower-left corner, unless it has been generated already
     void generateTerrain(int x_start, int z_start);
+    // Generates and lights every Chunk overlapping the given world-space area
+    // that hasn't been already. Generate one Chunk more on each side than will
+    // be drawn, since Chunks are only meshed once all their neighbors are lit
+    // (see Chunk::isReadyToMesh).
+    void generateArea(int minX, int maxX, int minZ, int maxZ);
+
+    // Queues every Chunk overlapping the given world-space area that hasn't
+    // been generated yet, for generateRequested to generate over the coming frames
+    void requestChunks(int minX, int maxX, int minZ, int maxZ);
+    // Generates up to maxChunks of the queued Chunks, nearest to focus
+    // first, as one batch. Returns how many are still queued.
+    int generateRequested(int maxChunks, glm::vec3 focus);
+    int requestedCount() const;
+    // How many feature blocks have been filed for Chunks other than the
+    // one whose feature placed them
+    int pendingBlockCount() const;
+    // How many Chunks have their features filed
+    int featureSourceCount() const;
+
+    // Unloads every Chunk that lies entirely outside the given world-space
+    // area, handing it to the ChunkPool for reuse, and returns how many
+    // were unloaded. Their terrain zones count as not generated, so they
+    // are generated again (identically, apart from any gameplay edits,
+    // which are lost) if they're requested later.
+    int unloadChunksOutside(int minX, int maxX, int minZ, int maxZ);
+    int chunkCount() const;
+    const ChunkPool& getChunkPool() const;
+
+    // Runs the parallel generation stages on threads, or serially if
+    // threads is nullptr. The pool must outlive this Terrain's use of it.
+    void setThreadPool(ThreadPool *threads);
+
+    // Sets the seed used by the height map functions. Must be called
+    // before any terrain is generated. A given seed always produces the
+    // same blocks and light, whatever order the zones are generated in.
+    void setSeed(int seed);
+    int getSeed() const;
+    // Sets how coarsely biome weights are sampled during generation: every
+    // step blocks (1 evaluates every column exactly; otherwise a power of
+    // two up to 16), accepting at most maxError of interpolation error.
+    // Must be called before any terrain is generated.
+    void setBiomeSampling(int step, float maxError);
+    // Turns cave carving on or off (it's on by default). Must be called
+    // before any terrain is generated.
+    void setCavesEnabled(bool enabled);
 
     // Initializes the Chunks that store the 64 x 256 x 64 block scene you
     // see when the base code is run.
@@ -93,7 +270,20 @@ public:
     int heightMapMountains(int x, int z);
     // "height" map of the biomes, determines which biome coords are in
     float heightMapBiome(int x, int z);
-    // populate all terrain blocks for the given x-z coords
+    // the raw FBM behind heightMapBiome, which interpolates more
+    // faithfully than the smoothstepped weight
+    float biomeNoise(int x, int z);
+    // the 3D noise caves are carved from; a block is hollowed out
+    // where it is high enough
+    float caveNoise(int x, int y, int z);
+    // biome weights of the Chunk with the given lower-left corner, indexed
+    // (x - x_start) + 16 * (z - z_start), sampled as set by setBiomeSampling
+    void fillBiomeWeights(int x_start, int z_start, float *weights);
+    // the ground height of the given x-z coords, blending
+    // each biome's height map by the column's biome weight
+    int heightMapTerrain(int x, int z, float biome);
+    // populate all terrain blocks for the given x-z coords, from
+    // the height map of the Chunk holding them
     void setColumnAt(int x, int z);
     void setColumnGrassland(int x, int z, int h);
     void setColumnMountains(int x, int z, int h);
@@ -0,0 +1,225 @@
+#include "terrainrenderer.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+ChunkDrawable::ChunkDrawable(OpenGLFunctions* context, const Chunk *chunk, QuadIndexBuffer *quadIndices)
+    : Drawable(context), mp_chunk(chunk), mp_quadIndices(quadIndices), m_uploadedRevision(0), m_uploadedOrigin(0)
+{}
+
+bool ChunkDrawable::isStale() const {
+    return m_count < 0 || m_uploadedRevision != mp_chunk->getRevision();
+}
+
+bool ChunkDrawable::hasMeshInPlace() const {
+    return m_count >= 0 && m_uploadedOrigin == mp_chunk->getOrigin();
+}
+
+void ChunkDrawable::createVBOdata()
+{
+    uint64_t revision = mp_chunk->getRevision();
+    ChunkMesh &mesh = ChunkMesh::scratch();
+    mp_chunk->createMeshData(&mesh);
+    upload(mesh, revision);
+}
+
+void ChunkDrawable::upload(const ChunkMesh &mesh, uint64_t revision)
+{
+    m_uploadedRevision = revision;
+    m_uploadedOrigin = mp_chunk->getOrigin();
+    this->m_count = ChunkMesh::INDICES_PER_FACE * mesh.faceCount();
+    this->m_countTransparent = ChunkMesh::INDICES_PER_FACE * mesh.faceCountTransparent();
+
+    PROFILE_ZONE("Chunk upload");
+    mp_quadIndices->reserve(glm::max(mesh.faceCount(), mesh.faceCountTransparent()));
+
+    if (!m_interleavedGenerated) generateInterleaved();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInterleaved);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+
+    if (!m_interleavedTransparentGenerated) generateInterleavedTransparent();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufInterleavedTransparent);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, mesh.verticesTransparent.size() * sizeof(float), mesh.verticesTransparent.data(), GL_STATIC_DRAW);
+}
+
+GLenum ChunkDrawable::bindIndices(bool transparent)
+{
+    return mp_quadIndices->bind((transparent ? m_countTransparent : m_count) / ChunkMesh::INDICES_PER_FACE);
+}
+
+int ChunkDrawable::faceCount()
+{
+    return (glm::max(m_count, 0) + glm::max(m_countTransparent, 0)) / ChunkMesh::INDICES_PER_FACE;
+}
+
+// How many Chunks per thread may be meshing at once. Each holds a
+// snapshot, so this bounds what edits have to copy as well.
+static const int MESH_JOBS_PER_THREAD = 2;
+
+TerrainRenderer::TerrainRenderer(OpenGLFunctions *context, ThreadPool *threads)
+    : m_drawables(), m_quadIndices(context), m_memoryStats(), mp_context(context),
+      mp_threads(threads), m_meshing(), m_done(), m_doneMutex(), m_jobDone(), m_meshes()
+{}
+
+void TerrainRenderer::setThreadPool(ThreadPool *threads) {
+    collectMeshes(true);
+    mp_threads = threads;
+}
+
+ChunkDrawable& TerrainRenderer::getDrawable(const Chunk *chunk) {
+    uPtr<ChunkDrawable> &drawable = m_drawables[chunk];
+    if(drawable == nullptr) {
+        drawable = mkU<ChunkDrawable>(mp_context, chunk, &m_quadIndices);
+    }
+    return *drawable;
+}
+
+void TerrainRenderer::uploadMesh(ChunkDrawable &drawable, const ChunkMesh &mesh, uint64_t revision) {
+    drawable.upload(mesh, revision);
+    m_memoryStats.uploads++;
+    m_memoryStats.uploadedVertexBytes += drawable.faceCount() * ChunkMesh::FLOATS_PER_FACE * sizeof(float);
+    m_memoryStats.uploadIndexBytesSaved += drawable.faceCount() * ChunkMesh::INDICES_PER_FACE * sizeof(GLuint);
+}
+
+void TerrainRenderer::collectMeshes(bool wait) {
+    std::vector<uPtr<MeshJob>> done;
+    {
+        std::unique_lock<std::mutex> lock(m_doneMutex);
+        if(wait) {
+            m_jobDone.wait(lock, [&]() { return m_done.size() == m_meshing.size(); });
+        }
+        done.swap(m_done);
+    }
+    for(uPtr<MeshJob> &job : done) {
+        const Chunk *chunk = job->snapshot->getSource();
+        m_meshing.erase(chunk);
+        if(job->snapshot->isCurrent()) {
+            uploadMesh(getDrawable(chunk), *job->mesh, job->snapshot->getRevision());
+        } else {
+            // Still stale, so it is meshed again on a later update
+            m_memoryStats.discardedMeshes++;
+        }
+        m_meshes.push_back(std::move(job->mesh));
+        // Snapshots are destroyed on this thread, the one editing the Chunks
+        job.reset();
+    }
+}
+
+void TerrainRenderer::updateDrawables(const std::vector<Chunk*> &chunks) {
+    collectMeshes(false);
+
+    int maxJobs = mp_threads != nullptr ? MESH_JOBS_PER_THREAD * mp_threads->threadCount() : 0;
+    for(Chunk *c : chunks) {
+        // Chunks at the edge of the generated world wait for their
+        // neighbors, rather than being meshed twice
+        if(!c->isReadyToMesh() || !getDrawable(c).isStale()) {
+            continue;
+        }
+        if(mp_threads == nullptr) {
+            // Nothing can edit the Chunk while it is meshed here, so it
+            // doesn't need a snapshot
+            ChunkMesh &mesh = ChunkMesh::scratch();
+            c->createMeshData(&mesh);
+            uploadMesh(getDrawable(c), mesh, c->getRevision());
+            continue;
+        }
+        if(static_cast<int>(m_meshing.size()) >= maxJobs) {
+            break;
+        }
+        if(m_meshing.count(c) > 0) {
+            continue;
+        }
+
+        uPtr<MeshJob> job = mkU<MeshJob>();
+        job->snapshot = mkU<ChunkSnapshot>(*c);
+        if(!m_meshes.empty()) {
+            job->mesh = std::move(m_meshes.back());
+            m_meshes.pop_back();
+        } else {
+            job->mesh = mkU<ChunkMesh>();
+        }
+        MeshJob *posted = job.release();
+        m_meshing.insert(c);
+        mp_threads->post([this, posted]() {
+            posted->snapshot->getChunk().createMeshData(posted->mesh.get());
+            {
+                std::lock_guard<std::mutex> lock(m_doneMutex);
+                m_done.emplace_back(posted);
+            }
+            m_jobDone.notify_all();
+        });
+    }
+}
+
+void TerrainRenderer::draw(const std::vector<Chunk*> &chunks, ShaderProgram *shaderProgram, RenderStats *stats) {
+    updateDrawables(chunks);
+
+    if(stats->samplesQuery[0] != 0) mp_context->glBeginQuery(GL_SAMPLES_PASSED, stats->samplesQuery[0]);
+    drawOpaque(chunks, shaderProgram, stats);
+    if(stats->samplesQuery[0] != 0) mp_context->glEndQuery(GL_SAMPLES_PASSED);
+
+    // Depth writes are disabled so that translucent faces never
+    // hide each other, only the opaque terrain does
+    mp_context->glEnable(GL_BLEND);
+    mp_context->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    mp_context->glDepthMask(GL_FALSE);
+    if(stats->samplesQuery[1] != 0) mp_context->glBeginQuery(GL_SAMPLES_PASSED, stats->samplesQuery[1]);
+    drawTransparent(chunks, shaderProgram, stats);
+    if(stats->samplesQuery[1] != 0) mp_context->glEndQuery(GL_SAMPLES_PASSED);
+    mp_context->glDepthMask(GL_TRUE);
+    mp_context->glDisable(GL_BLEND);
+}
+
+void TerrainRenderer::drawOpaque(const std::vector<Chunk*> &chunks, ShaderProgram *shaderProgram, RenderStats *stats) {
+    for(Chunk *c : chunks) {
+        ChunkDrawable &drawable = getDrawable(c);
+        // An edited Chunk keeps drawing its last mesh until the new one is
+        // uploaded, but one that was unloaded and reused elsewhere isn't
+        // drawn until it has been meshed there
+        if(!drawable.hasMeshInPlace() || drawable.elemCount() <= 0) {
+            continue;
+        }
+        glm::ivec2 origin = c->getOrigin();
+        shaderProgram->setModelMatrix(translate(mat4(), vec3(origin.x, 0, origin.y)));
+        shaderProgram->drawInterleaved(drawable);
+
+        stats->drawCalls++;
+        stats->triangles += drawable.elemCount() / 3;
+    }
+}
+
+void TerrainRenderer::drawTransparent(const std::vector<Chunk*> &chunks, ShaderProgram *shaderProgram, RenderStats *stats) {
+    for(auto it = chunks.rbegin(); it != chunks.rend(); ++it) {
+        Chunk *c = *it;
+        ChunkDrawable &drawable = getDrawable(c);
+        if(!drawable.hasMeshInPlace() || drawable.elemCountTransparent() <= 0) {
+            continue;
+        }
+        glm::ivec2 origin = c->getOrigin();
+        shaderProgram->setModelMatrix(translate(mat4(), vec3(origin.x, 0, origin.y)));
+        shaderProgram->drawInterleaved(drawable, true);
+
+        stats->drawCalls++;
+        stats->triangles += drawable.elemCountTransparent() / 3;
+    }
+}
+
+TerrainMemoryStats TerrainRenderer::getMemoryStats() {
+    TerrainMemoryStats stats = m_memoryStats;
+    stats.vertexBytes = stats.perChunkIndexBytes = 0;
+    for(auto &kv : m_drawables) {
+        int faces = kv.second->faceCount();
+        stats.vertexBytes += faces * ChunkMesh::FLOATS_PER_FACE * sizeof(float);
+        stats.perChunkIndexBytes += faces * ChunkMesh::INDICES_PER_FACE * sizeof(GLuint);
+    }
+    stats.sharedIndexBytes = m_quadIndices.byteSize();
+    return stats;
+}
+
+void TerrainRenderer::destroy() {
+    collectMeshes(true);
+    for(auto &kv : m_drawables) {
+        kv.second->destroyVBOdata();
+    }
+    m_drawables.clear();
+    m_quadIndices.destroy();
+}
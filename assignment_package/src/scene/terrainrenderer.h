@@ -0,0 +1,141 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "glm_includes.h"
+#include "drawable.h"
+#include "shaderprogram.h"
+#include "chunk.h"
+#include "chunksnapshot.h"
+#include "quadindexbuffer.h"
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class ThreadPool;
+
+// Counters accumulated by TerrainRenderer::draw over one frame
+struct RenderStats {
+    int drawCalls;
+    int triangles;
+    // If nonzero, GL_SAMPLES_PASSED queries that TerrainRenderer::draw wraps
+    // around its opaque and translucent passes. Their results are left for
+    // the caller to read back, ideally a frame later.
+    GLuint samplesQuery[2];
+
+    RenderStats() : drawCalls(0), triangles(0), samplesQuery{0, 0}
+    {}
+};
+
+// What a TerrainRenderer has uploaded, and held, for its Chunks' meshes
+struct TerrainMemoryStats {
+    int uploads;                  // Meshes uploaded since the renderer was created
+    int discardedMeshes;          // Meshes thrown away because their Chunk changed while they were built
+    size_t uploadedVertexBytes;   // Vertex data those uploads sent to the GPU
+    size_t uploadIndexBytesSaved; // Indices they would have sent with an index buffer per Chunk
+    size_t vertexBytes;           // Vertex data held on the GPU now
+    size_t sharedIndexBytes;      // Held by the shared QuadIndexBuffer
+    size_t perChunkIndexBytes;    // What per-Chunk 32-bit index buffers would hold instead
+
+    TerrainMemoryStats()
+        : uploads(0), discardedMeshes(0), uploadedVertexBytes(0), uploadIndexBytesSaved(0),
+          vertexBytes(0), sharedIndexBytes(0), perChunkIndexBytes(0)
+    {}
+};
+
+// The GPU copy of one Chunk's mesh. Only its vertices are its own; its
+// faces are drawn with the renderer's shared QuadIndexBuffer.
+class ChunkDrawable : public Drawable {
+private:
+    const Chunk *mp_chunk;
+    QuadIndexBuffer *mp_quadIndices;
+    uint64_t m_uploadedRevision; // The Chunk revision the buffers were built from
+    glm::ivec2 m_uploadedOrigin; // Where the Chunk was when they were built
+
+public:
+    ChunkDrawable(OpenGLFunctions* context, const Chunk *chunk, QuadIndexBuffer *quadIndices);
+
+    // True if the Chunk has changed since its mesh was last uploaded
+    bool isStale() const;
+    // True if there is an uploaded mesh of the Chunk where it is now. One
+    // that is merely stale is still drawn until its new mesh is uploaded;
+    // one of a Chunk the pool has since moved elsewhere isn't.
+    bool hasMeshInPlace() const;
+
+    // Meshes the Chunk on the CPU, into this thread's scratch
+    // ChunkMesh, and uploads the result
+    void createVBOdata() override;
+    // Uploads a mesh built elsewhere from the Chunk as it was at the given revision
+    void upload(const ChunkMesh &mesh, uint64_t revision);
+    GLenum bindIndices(bool transparent) override;
+
+    // Faces in the uploaded mesh, opaque and translucent together
+    int faceCount();
+};
+
+// Draws the Chunks of a Terrain. The Terrain itself knows nothing about
+// OpenGL, so the renderer keeps one ChunkDrawable per Chunk it has drawn
+// and re-meshes it whenever the Chunk's revision changes.
+//
+// Given a ThreadPool, it meshes the changed Chunks in the background:
+// each update takes ChunkSnapshots of some changed Chunks and posts them
+// to the workers, and uploads, on the calling (GL) thread, the meshes
+// finished since the last update. A mesh whose Chunk was edited after its
+// snapshot was taken is thrown away rather than uploaded, and the Chunk is
+// meshed again. Until then each Chunk keeps drawing its last mesh.
+// Without a ThreadPool, the changed Chunks are meshed and uploaded right
+// away, with no snapshots.
+class TerrainRenderer {
+private:
+    // A Chunk being meshed on mp_threads
+    struct MeshJob {
+        uPtr<ChunkSnapshot> snapshot;
+        uPtr<ChunkMesh> mesh;
+    };
+
+    std::unordered_map<const Chunk*, uPtr<ChunkDrawable>> m_drawables;
+    QuadIndexBuffer m_quadIndices;
+    TerrainMemoryStats m_memoryStats; // Only the upload counters are kept up to date
+
+    OpenGLFunctions* mp_context;
+    ThreadPool *mp_threads; // May be nullptr, to mesh on the calling thread
+    // The Chunks posted to mp_threads whose meshes haven't been collected
+    std::unordered_set<const Chunk*> m_meshing;
+    // Finished jobs, for the next update to collect, guarded by m_doneMutex
+    std::vector<uPtr<MeshJob>> m_done;
+    std::mutex m_doneMutex;
+    std::condition_variable m_jobDone;
+    // Meshes of collected jobs, reused by later ones so their buffers stop growing
+    std::vector<uPtr<ChunkMesh>> m_meshes;
+
+    ChunkDrawable& getDrawable(const Chunk *chunk);
+    void uploadMesh(ChunkDrawable &drawable, const ChunkMesh &mesh, uint64_t revision);
+    // Uploads the meshes finished since the last call, or waits for every
+    // posted one if wait is set
+    void collectMeshes(bool wait);
+
+public:
+    TerrainRenderer(OpenGLFunctions *context, ThreadPool *threads = nullptr);
+
+    void setThreadPool(ThreadPool *threads);
+
+    // Uploads the meshes finished since the last update and re-meshes every
+    // given Chunk that changed since it was last drawn, in the background if
+    // there is a ThreadPool. Chunks that aren't ready to mesh yet are
+    // skipped.
+    void updateDrawables(const std::vector<Chunk*> &chunks);
+
+    // Draws the given front-to-back sorted Chunks in two passes: first
+    // their opaque geometry in order, so early depth testing can reject
+    // hidden fragments, then their translucent geometry in reverse order
+    // with blending enabled.
+    void draw(const std::vector<Chunk*> &chunks, ShaderProgram *shaderProgram, RenderStats *stats);
+    void drawOpaque(const std::vector<Chunk*> &chunks, ShaderProgram *shaderProgram, RenderStats *stats);
+    void drawTransparent(const std::vector<Chunk*> &chunks, ShaderProgram *shaderProgram, RenderStats *stats);
+
+    TerrainMemoryStats getMemoryStats();
+
+    // Waits for the meshes still being built, then frees every Chunk's
+    // VBOs. The GL context must be current.
+    void destroy();
+};
@@ -4,14 +4,15 @@
 #include <QTextStream>
 #include <QDebug>
 #include <stdexcept>
+#include "scene/chunk.h"
 
 #include <iostream>
 
 
-ShaderProgram::ShaderProgram(OpenGLContext *context)
+ShaderProgram::ShaderProgram(OpenGLFunctions *context)
     : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrCol(-1),
-      unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),
+      attrPos(-1), attrNor(-1), attrCol(-1), attrPosOffset(-1), attrUV(-1), attrLight(-1), attrAO(-1),
+      unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1), unifTexture(-1),
       context(context)
 {}
 
@@ -68,11 +69,15 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     attrCol = context->glGetAttribLocation(prog, "vs_Col");
     if(attrCol == -1) attrCol = context->glGetAttribLocation(prog, "vs_ColInstanced");
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
+    attrUV = context->glGetAttribLocation(prog, "vs_UV");
+    attrLight = context->glGetAttribLocation(prog, "vs_Light");
+    attrAO = context->glGetAttribLocation(prog, "vs_AO");
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
     unifViewProj   = context->glGetUniformLocation(prog, "u_ViewProj");
     unifColor      = context->glGetUniformLocation(prog, "u_Color");
+    unifTexture    = context->glGetUniformLocation(prog, "u_Texture");
 }
 
 void ShaderProgram::useMe()
@@ -138,6 +143,16 @@ void ShaderProgram::setGeometryColor(glm::vec4 color)
     }
 }
 
+void ShaderProgram::setTextureSlot(int slot)
+{
+    useMe();
+
+    if(unifTexture != -1)
+    {
+        context->glUniform1i(unifTexture, slot);
+    }
+}
+
 //This function, as its name implies, uses the passed in GL widget
 void ShaderProgram::draw(Drawable &d)
 {
@@ -184,12 +199,17 @@ void ShaderProgram::draw(Drawable &d)
 }
 
 //This function, as its name implies, uses the passed in GL widget
-void ShaderProgram::drawInterleaved(Drawable &d)
+void ShaderProgram::drawInterleaved(Drawable &d, bool transparent)
 {
     useMe();
 
-    if(d.elemCount() < 0) {
-        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCount()) + "!");
+    int count = transparent ? d.elemCountTransparent() : d.elemCount();
+    if(count < 0) {
+        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(count) + "!");
+    }
+    // Nothing to draw (e.g. a Chunk without any water), so don't issue a draw call
+    if(count == 0) {
+        return;
     }
 
 
@@ -202,32 +222,52 @@ void ShaderProgram::drawInterleaved(Drawable &d)
     // glBindBuffer on the Drawable's VBO for vertex position,
     // meaning that glVertexAttribPointer associates vs_Pos
     // (referred to by attrPos) with that VBO
-    if (d.bindInterleaved()){
+    // Interleaved vertices are laid out as pos (vec4), nor (vec4), col (vec4), uv (vec2), light (vec2), ao (float)
+    if (transparent ? d.bindInterleavedTransparent() : d.bindInterleaved()){
+        const int stride = ChunkMesh::FLOATS_PER_VERTEX * sizeof(float);
 
         if (attrPos != -1) {
             context->glEnableVertexAttribArray(attrPos);
-            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 12 * sizeof(float), static_cast<void*> (0));
+            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, stride, static_cast<void*> (0));
         }
 
         if (attrNor != -1) {
             context->glEnableVertexAttribArray(attrNor);
-            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 12 * sizeof(float), (void*)(4 * sizeof(float)));
+            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, stride, (void*)(4 * sizeof(float)));
         }
 
         if (attrCol != -1) {
             context->glEnableVertexAttribArray(attrCol);
-            context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 12 * sizeof(float), (void*)(8 * sizeof(float)));
+            context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, stride, (void*)(8 * sizeof(float)));
+        }
+
+        if (attrUV != -1) {
+            context->glEnableVertexAttribArray(attrUV);
+            context->glVertexAttribPointer(attrUV, 2, GL_FLOAT, false, stride, (void*)(12 * sizeof(float)));
+        }
+
+        if (attrLight != -1) {
+            context->glEnableVertexAttribArray(attrLight);
+            context->glVertexAttribPointer(attrLight, 2, GL_FLOAT, false, stride, (void*)(14 * sizeof(float)));
+        }
+
+        if (attrAO != -1) {
+            context->glEnableVertexAttribArray(attrAO);
+            context->glVertexAttribPointer(attrAO, 1, GL_FLOAT, false, stride, (void*)(16 * sizeof(float)));
         }
     }
 
     // Bind the index buffer and then draw shapes from it.
     // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
+    GLenum indexType = d.bindIndices(transparent);
+    context->glDrawElements(d.drawMode(), count, indexType, 0);
 
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
     if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
+    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
+    if (attrLight != -1) context->glDisableVertexAttribArray(attrLight);
+    if (attrAO != -1) context->glDisableVertexAttribArray(attrAO);
 
     context->printGLErrorLog();
 }
@@ -280,10 +320,17 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
     context->glDrawElementsInstanced(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, d.instanceCount());
     context->printGLErrorLog();
 
+    // Divisors are part of the shared VAO, so put them back for non-instanced draws
     if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
     if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrPosOffset != -1) context->glDisableVertexAttribArray(attrPosOffset);
+    if (attrCol != -1) {
+        context->glVertexAttribDivisor(attrCol, 0);
+        context->glDisableVertexAttribArray(attrCol);
+    }
+    if (attrPosOffset != -1) {
+        context->glVertexAttribDivisor(attrPosOffset, 0);
+        context->glDisableVertexAttribArray(attrPosOffset);
+    }
 
 }
 
@@ -19,14 +19,18 @@ public:
     int attrNor; // A handle for the "in" vec4 representing vertex normal in the vertex shader
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
+    int attrUV; // A handle for the "in" vec2 representing the texture atlas coordinates of a vertex
+    int attrLight; // A handle for the "in" vec2 representing the sky and block light of a vertex
+    int attrAO; // A handle for the "in" float representing the ambient occlusion of a vertex
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
     int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
     int unifColor; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
+    int unifTexture; // A handle for the "uniform" sampler2D holding the block texture atlas
 
 public:
-    ShaderProgram(OpenGLContext* context);
+    ShaderProgram(OpenGLFunctions* context);
     // Sets up the requisite GL data and shaders from the given .glsl files
     void create(const char *vertfile, const char *fragfile);
     // Tells our OpenGL context to use this shader to draw things
@@ -37,11 +41,14 @@ public:
     void setViewProjMatrix(const glm::mat4 &vp);
     // Pass the given color to this shader on the GPU
     void setGeometryColor(glm::vec4 color);
+    // Tell this shader which texture unit its sampler should read from
+    void setTextureSlot(int slot);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
 
-    // Draw the given object to our screen using this ShaderProgram's shaders
-    void drawInterleaved(Drawable &d);
+    // Draw the given object to our screen using this ShaderProgram's shaders.
+    // If transparent is set, the Drawable's transparent buffers are drawn instead.
+    void drawInterleaved(Drawable &d, bool transparent = false);
 
     // Draw the given object to our screen multiple times using instanced rendering
     void drawInstanced(InstancedDrawable &d);
@@ -55,7 +62,7 @@ public:
     QString qTextFileRead(const char*);
 
 private:
-    OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
+    OpenGLFunctions* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
 };
@@ -1,43 +1,42 @@
 INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
+# The world itself (Terrain, Chunk, ...) is listed in core.pri and
+# linked in from the core static library
+
 SOURCES += \
     $$PWD/main.cpp \
     $$PWD/mainwindow.cpp \
     $$PWD/mygl.cpp \
-    $$PWD/scene/blocktype.cpp \
-    $$PWD/scene/direction.cpp \
-    $$PWD/scene/noise.cpp \
     $$PWD/shaderprogram.cpp \
     $$PWD/drawable.cpp \
     $$PWD/cameracontrolshelp.cpp \
     $$PWD/scene/cube.cpp \
     $$PWD/openglcontext.cpp \
-    $$PWD/scene/terrain.cpp \
     $$PWD/scene/worldaxes.cpp \
     $$PWD/scene/entity.cpp \
     $$PWD/scene/player.cpp \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
-    $$PWD/scene/chunk.cpp
+    $$PWD/scene/terrainrenderer.cpp \
+    $$PWD/texture.cpp \
+    $$PWD/quadindexbuffer.cpp \
+    $$PWD/renderbenchmark.cpp
 
 HEADERS += \
     $$PWD/mainwindow.h \
     $$PWD/mygl.h \
-    $$PWD/scene/blocktype.h \
-    $$PWD/scene/direction.h \
-    $$PWD/scene/noise.h \
     $$PWD/shaderprogram.h \
     $$PWD/drawable.h \
     $$PWD/cameracontrolshelp.h \
     $$PWD/scene/cube.h \
     $$PWD/openglcontext.h \
-    $$PWD/scene/terrain.h \
     $$PWD/scene/worldaxes.h \
-    $$PWD/smartpointerhelp.h \
-    $$PWD/glm_includes.h \
     $$PWD/scene/entity.h \
     $$PWD/scene/player.h \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
-    $$PWD/scene/chunk.h
+    $$PWD/scene/terrainrenderer.h \
+    $$PWD/texture.h \
+    $$PWD/quadindexbuffer.h \
+    $$PWD/renderbenchmark.h
@@ -0,0 +1,56 @@
+#include "texture.h"
+#include <QImage>
+#include <stdexcept>
+#include "profiler.h"
+
+Texture::Texture(OpenGLFunctions *context)
+    : m_textureHandle(), m_generated(false), mp_context(context)
+{}
+
+Texture::~Texture()
+{}
+
+void Texture::create(const char *imagePath, int maxMipLevel)
+{
+    QImage image(imagePath);
+    if (image.isNull()) {
+        throw std::runtime_error(std::string("Could not load texture ") + imagePath);
+    }
+    // QImage stores rows top to bottom, but OpenGL expects the first
+    // row to be the bottom of the image
+    image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+    PROFILE_ZONE("Texture upload");
+    if (!m_generated) {
+        mp_context->glGenTextures(1, &m_textureHandle);
+        m_generated = true;
+    }
+    mp_context->glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(), 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+
+    // Keep magnified texels crisp, but average them when minified
+    // so distant terrain doesn't shimmer
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxMipLevel);
+    mp_context->glGenerateMipmap(GL_TEXTURE_2D);
+
+    mp_context->printGLErrorLog();
+}
+
+void Texture::bind(int slot)
+{
+    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
+    mp_context->glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+}
+
+void Texture::destroy()
+{
+    if (m_generated) {
+        mp_context->glDeleteTextures(1, &m_textureHandle);
+        m_generated = false;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <openglcontext.h>
+
+// A 2D texture loaded from an image file (or Qt resource) and uploaded
+// to the GPU, optionally with a full mipmap chain.
+class Texture
+{
+private:
+    GLuint m_textureHandle;
+    bool m_generated;
+
+    OpenGLFunctions* mp_context;
+
+public:
+    Texture(OpenGLFunctions* context);
+    ~Texture();
+
+    // Loads the image at the given path and uploads it to the GPU.
+    // maxMipLevel caps how far the image is downsampled; for a texture
+    // atlas this keeps distant faces from blending neighboring tiles.
+    void create(const char *imagePath, int maxMipLevel);
+    // Binds this texture to the given texture unit
+    void bind(int slot);
+    void destroy();
+};
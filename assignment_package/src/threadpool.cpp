@@ -0,0 +1,130 @@
+#include "threadpool.h"
+#include <algorithm>
+
+// Set while the current thread is running a range of some loop
+static thread_local bool t_insideLoop = false;
+
+ThreadPool::ThreadPool(int workerCount)
+    : m_workers(), m_mutex(), m_workReady(), m_workDone(),
+      mp_body(nullptr), m_count(0), m_grainSize(1), m_nextIndex(0),
+      m_activeWorkers(0), m_generation(0), m_stopping(false), m_tasks()
+{
+    if (workerCount < 0) {
+        workerCount = std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workReady.notify_all();
+    for (std::thread &t : m_workers) {
+        t.join();
+    }
+}
+
+int ThreadPool::threadCount() const
+{
+    return static_cast<int>(m_workers.size()) + 1;
+}
+
+void ThreadPool::runRanges()
+{
+    t_insideLoop = true;
+    for (;;) {
+        int begin = m_nextIndex.fetch_add(m_grainSize, std::memory_order_relaxed);
+        if (begin >= m_count) {
+            break;
+        }
+        (*mp_body)(begin, std::min(begin + m_grainSize, m_count));
+    }
+    t_insideLoop = false;
+}
+
+void ThreadPool::workerMain()
+{
+    unsigned seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workReady.wait(lock, [&]() {
+                return m_stopping || m_generation != seenGeneration || !m_tasks.empty();
+            });
+            // A loop goes first, since the thread that started it is waiting on it
+            if (m_generation == seenGeneration) {
+                if (m_tasks.empty()) {
+                    return;
+                }
+                std::function<void()> task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+                lock.unlock();
+                task();
+                continue;
+            }
+            seenGeneration = m_generation;
+            m_activeWorkers++;
+        }
+
+        runRanges();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_activeWorkers--;
+        }
+        m_workDone.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grainSize, const std::function<void(int, int)> &body)
+{
+    if (count <= 0) {
+        return;
+    }
+    grainSize = std::max(1, grainSize);
+
+    // Not worth waking anyone up for, or already inside a loop
+    if (m_workers.empty() || count <= grainSize || t_insideLoop) {
+        body(0, count);
+        return;
+    }
+
+    {
+        // A worker that woke up too late for the previous loop may
+        // still be on its way out of it
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_workDone.wait(lock, [&]() { return m_activeWorkers == 0; });
+        mp_body = &body;
+        m_count = count;
+        m_grainSize = grainSize;
+        m_nextIndex.store(0, std::memory_order_relaxed);
+        m_generation++;
+    }
+    m_workReady.notify_all();
+
+    runRanges();
+
+    // Every range has been handed out; wait for the workers still running one.
+    // Workers that wake up late find no ranges left and leave immediately.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workDone.wait(lock, [&]() { return m_activeWorkers == 0; });
+    mp_body = nullptr;
+}
+
+void ThreadPool::post(std::function<void()> task)
+{
+    if (m_workers.empty()) {
+        task();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_workReady.notify_one();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for data-parallel loops over the world.
+//
+// parallelFor() splits [0, count) into ranges of grainSize elements and
+// hands them out to the workers and to the calling thread, returning once
+// every range is done. Only one loop runs at a time; calling parallelFor
+// from inside a loop body runs the inner loop serially.
+//
+// post() queues a task for the workers without waiting for it, for work
+// that finishes over several frames. Idle workers take tasks one at a
+// time; a worker running a task joins a loop once it is done with it.
+class ThreadPool
+{
+private:
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_workReady;
+    std::condition_variable m_workDone;
+
+    // The loop currently being run, guarded by m_mutex
+    const std::function<void(int, int)> *mp_body;
+    int m_count;
+    int m_grainSize;
+    std::atomic<int> m_nextIndex;
+    int m_activeWorkers;   // Workers still inside the current loop
+    unsigned m_generation; // Incremented for every loop, so workers join each one once
+    bool m_stopping;
+    // Tasks queued by post that no worker has taken yet, guarded by m_mutex
+    std::deque<std::function<void()>> m_tasks;
+
+    // Runs ranges of the current loop until none are left
+    void runRanges();
+    void workerMain();
+
+public:
+    // Starts the given number of worker threads. By default, one fewer than
+    // the hardware supports, since the calling thread takes part as well.
+    explicit ThreadPool(int workerCount = -1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // The number of threads that run a loop, including the caller
+    int threadCount() const;
+
+    // Calls body(begin, end) on disjoint ranges covering [0, count)
+    void parallelFor(int count, int grainSize, const std::function<void(int, int)> &body);
+    // Runs task on a worker, or right away on the calling thread if there
+    // are no workers. Tasks still queued when the pool is destroyed are
+    // run before the workers stop. A task must not call parallelFor.
+    void post(std::function<void()> task);
+};